@@ -15,7 +15,46 @@ namespace NRenderer
 		enum class Acceleration { NONE, KD_TREE };
 		Acceleration acc;
 		unsigned int PhotonsPerLight;
+		unsigned int PhotonBudget;
 		unsigned int NeighborPhotons;
+		float KNNEpsilon;
+		unsigned int PhotonMemoryMB;
+		unsigned int CausticPhotonsPerLight;
+		unsigned int CausticNeighborPhotons;
+		bool DirectLighting;
+		unsigned int ShadowRays;
+		bool FinalGather;
+		unsigned int GatherRays;
+		float IrradianceCacheAccuracy;
+		bool PrecomputeIrradiance;
+		bool SavePhotonMap;
+		bool BatchedGather;
+		bool ProjectionMaps;
+		bool QMCEmission;
+		bool SPPM;
+		unsigned int SPPMPasses;
+		unsigned int SPPMPhotonsPerPass;
+		float SPPMInitialRadius;
+		bool LightSampling;
+		bool LightBVH;
+		unsigned int RussianRouletteDepth;
+		bool AdaptiveSampling;
+		unsigned int MinSamples;
+		unsigned int MaxSamples;
+		bool Progressive;
+		unsigned int PassSamples;
+		unsigned int TileSize;
+		unsigned int Threads;
+		enum class SamplerType { INDEPENDENT, HALTON, SOBOL, PMJ02 };
+		SamplerType Sampler;
+		bool Denoise;
+		unsigned int DenoiseIterations;
+		bool Restir;
+		unsigned int RestirCandidates;
+		unsigned int RestirNeighbors;
+		float RestirRadius;
+		// 颜色之外要输出的通道, channelBit(Channel)的组合
+		unsigned int AOVChannels;
 		RenderSettings()
 			: width(500)
 			, height(500)
@@ -23,7 +62,44 @@ namespace NRenderer
 			, samplesPerPixel(16)
 			, acc(Acceleration::NONE)
 			, PhotonsPerLight(10000)
+			, PhotonBudget(0)
 			, NeighborPhotons(250)
+			, KNNEpsilon(0.f)
+			, PhotonMemoryMB(0)
+			, CausticPhotonsPerLight(0)
+			, CausticNeighborPhotons(80)
+			, DirectLighting(false)
+			, ShadowRays(4)
+			, FinalGather(false)
+			, GatherRays(64)
+			, IrradianceCacheAccuracy(0.2f)
+			, PrecomputeIrradiance(false)
+			, SavePhotonMap(false)
+			, BatchedGather(false)
+			, ProjectionMaps(false)
+			, QMCEmission(false)
+			, SPPM(false)
+			, SPPMPasses(64)
+			, SPPMPhotonsPerPass(20000)
+			, SPPMInitialRadius(10.f)
+			, LightSampling(false)
+			, LightBVH(false)
+			, RussianRouletteDepth(3)
+			, AdaptiveSampling(false)
+			, MinSamples(8)
+			, MaxSamples(256)
+			, Progressive(false)
+			, PassSamples(1)
+			, TileSize(16)
+			, Threads(0)
+			, Sampler(SamplerType::INDEPENDENT)
+			, Denoise(false)
+			, DenoiseIterations(5)
+			, Restir(false)
+			, RestirCandidates(32)
+			, RestirNeighbors(5)
+			, RestirRadius(10.f)
+			, AOVChannels(0)
 		{}
 	};
 	struct AmbientSettings
@@ -10,7 +10,44 @@ namespace NRenderer
         ro.height = renderSettings.height;
         ro.acc = renderSettings.acc;
         ro.photonsPerLight = renderSettings.PhotonsPerLight;
+        ro.photonBudget = renderSettings.PhotonBudget;
         ro.neighborPhotons = renderSettings.NeighborPhotons;
+        ro.knnEpsilon = renderSettings.KNNEpsilon;
+        ro.photonMemoryMB = renderSettings.PhotonMemoryMB;
+        ro.causticPhotonsPerLight = renderSettings.CausticPhotonsPerLight;
+        ro.causticNeighborPhotons = renderSettings.CausticNeighborPhotons;
+        ro.directLighting = renderSettings.DirectLighting;
+        ro.shadowRays = renderSettings.ShadowRays;
+        ro.finalGather = renderSettings.FinalGather;
+        ro.gatherRays = renderSettings.GatherRays;
+        ro.irradianceCacheAccuracy = renderSettings.IrradianceCacheAccuracy;
+        ro.precomputeIrradiance = renderSettings.PrecomputeIrradiance;
+        ro.savePhotonMap = renderSettings.SavePhotonMap;
+        ro.batchedGather = renderSettings.BatchedGather;
+        ro.projectionMaps = renderSettings.ProjectionMaps;
+        ro.qmcEmission = renderSettings.QMCEmission;
+        ro.sppm = renderSettings.SPPM;
+        ro.sppmPasses = renderSettings.SPPMPasses;
+        ro.sppmPhotonsPerPass = renderSettings.SPPMPhotonsPerPass;
+        ro.sppmInitialRadius = renderSettings.SPPMInitialRadius;
+        ro.lightSampling = renderSettings.LightSampling;
+        ro.lightBVH = renderSettings.LightBVH;
+        ro.russianRouletteDepth = renderSettings.RussianRouletteDepth;
+        ro.adaptiveSampling = renderSettings.AdaptiveSampling;
+        ro.minSamples = renderSettings.MinSamples;
+        ro.maxSamples = renderSettings.MaxSamples;
+        ro.progressive = renderSettings.Progressive;
+        ro.passSamples = renderSettings.PassSamples;
+        ro.tileSize = renderSettings.TileSize;
+        ro.threads = renderSettings.Threads;
+        ro.sampler = renderSettings.Sampler;
+        ro.denoise = renderSettings.Denoise;
+        ro.denoiseIterations = renderSettings.DenoiseIterations;
+        ro.restir = renderSettings.Restir;
+        ro.restirCandidates = renderSettings.RestirCandidates;
+        ro.restirNeighbors = renderSettings.RestirNeighbors;
+        ro.restirRadius = renderSettings.RestirRadius;
+        ro.aovChannels = renderSettings.AOVChannels;
         this->scene->renderOption = ro;
     }
 
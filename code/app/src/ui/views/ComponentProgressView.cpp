@@ -20,6 +20,16 @@ namespace NRenderer
             if (componentManager.getState() == ComponentManager::State::RUNNING) {
                 uiContext.state = UIContext::State::HOVER_COMPONENT_PROGRESS;
                 ImGui::TextUnformatted(("正在执行: " + activeComponentInfo.id).c_str());
+                // 渐进式渲染在当前一轮结束后停止, 保留已有的结果; 不分轮的渲染不显示Stop
+                auto& control = getServer().control;
+                if (control.isStoppable()) {
+                    if (control.stopRequested()) {
+                        ImGui::TextUnformatted("正在停止...");
+                    }
+                    else if (ImGui::Button("Stop##ComponentProgress")) {
+                        control.requestStop();
+                    }
+                }
             }
             else if (componentManager.getState() == ComponentManager::State::READY) {
                 uiContext.state = UIContext::State::HOVER_COMPONENT_PROGRESS;
@@ -41,6 +41,16 @@ namespace NRenderer
 		ImGui::InputScalar("Height", ImGuiDataType_U32, &rs.height, &intStep, NULL, "%u");
 		ImGui::InputScalar("Depth", ImGuiDataType_U32, &rs.depth, &intStep, NULL, "%u");
 		ImGui::InputScalar("Sample Nums", ImGuiDataType_U32, &rs.samplesPerPixel, &intStep, NULL, "%u");
+		ImGui::InputScalar("Tile Size", ImGuiDataType_U32, &rs.TileSize, &intStep, NULL, "%u");
+		ImGui::InputScalar("Threads (0: auto)", ImGuiDataType_U32, &rs.Threads, &intStep, NULL, "%u");
+		ImGui::Checkbox("Denoise##RenderSettings", &rs.Denoise);
+		if (rs.Denoise) {
+			ImGui::InputScalar("Denoise Iterations##RenderSettings", ImGuiDataType_U32, &rs.DenoiseIterations, &intStep, NULL, "%u");
+		}
+		ImGui::TextUnformatted("Output Channels:");
+		for (unsigned int c = 1; c < CHANNEL_NUMS; c++) {
+			ImGui::CheckboxFlags((string(channelName(Channel(c))) + "##RenderSettingsAOV").c_str(), &rs.AOVChannels, channelBit(Channel(c)));
+		}
 
 		const string acc_str[] = { "NONE", "KD_TREE" };
 		int curr = rs.acc == RenderSettings::Acceleration::NONE ? 0 : 1;
@@ -58,7 +68,72 @@ namespace NRenderer
 			}
 
 			ImGui::InputScalar("Photons/Light", ImGuiDataType_U32, &rs.PhotonsPerLight, &intStep, NULL, "%u");
+			ImGui::InputScalar("Photon Budget", ImGuiDataType_U32, &rs.PhotonBudget, &intStep, NULL, "%u");
 			ImGui::InputScalar("NeighborPhotons", ImGuiDataType_U32, &rs.NeighborPhotons, &intStep, NULL, "%u");
+			float floatStep = 0.1;
+			ImGui::InputScalar("kNN Epsilon", ImGuiDataType_Float, &rs.KNNEpsilon, &floatStep, NULL);
+			ImGui::InputScalar("Photon Memory (MB)", ImGuiDataType_U32, &rs.PhotonMemoryMB, &intStep, NULL, "%u");
+			ImGui::InputScalar("Caustic Photons/Light", ImGuiDataType_U32, &rs.CausticPhotonsPerLight, &intStep, NULL, "%u");
+			ImGui::InputScalar("Caustic Neighbors", ImGuiDataType_U32, &rs.CausticNeighborPhotons, &intStep, NULL, "%u");
+
+			ImGui::Checkbox("Precompute Irradiance##RenderSettings", &rs.PrecomputeIrradiance);
+			ImGui::Checkbox("Save Photon Map##RenderSettings", &rs.SavePhotonMap);
+			ImGui::Checkbox("Batched Gather##RenderSettings", &rs.BatchedGather);
+			ImGui::Checkbox("Projection Maps##RenderSettings", &rs.ProjectionMaps);
+			ImGui::Checkbox("QMC Emission##RenderSettings", &rs.QMCEmission);
+
+			ImGui::Checkbox("Direct Lighting##RenderSettings", &rs.DirectLighting);
+			if (rs.DirectLighting) {
+				ImGui::InputScalar("Shadow Rays", ImGuiDataType_U32, &rs.ShadowRays, &intStep, NULL, "%u");
+				ImGui::Checkbox("Light BVH##RenderSettings", &rs.LightBVH);
+			}
+
+			ImGui::Checkbox("Final Gather##RenderSettings", &rs.FinalGather);
+			if (rs.FinalGather) {
+				ImGui::InputScalar("Gather Rays", ImGuiDataType_U32, &rs.GatherRays, &intStep, NULL, "%u");
+				ImGui::InputScalar("Cache Accuracy", ImGuiDataType_Float, &rs.IrradianceCacheAccuracy, &floatStep, NULL);
+			}
+			ImGui::Checkbox("SPPM##RenderSettings", &rs.SPPM);
+			if (rs.SPPM) {
+				ImGui::InputScalar("SPPM Passes", ImGuiDataType_U32, &rs.SPPMPasses, &intStep, NULL, "%u");
+				ImGui::InputScalar("Photons/Light/Pass", ImGuiDataType_U32, &rs.SPPMPhotonsPerPass, &intStep, NULL, "%u");
+				ImGui::InputScalar("Initial Radius", ImGuiDataType_Float, &rs.SPPMInitialRadius, &floatStep, NULL);
+			}
+		}
+		if (components.size() > currComponentSelected && components[currComponentSelected].name == "SimplePathTracer") {
+			const string sampler_str[] = { "Independent", "Halton", "Sobol", "PMJ02" };
+			int currSampler = int(rs.Sampler);
+			if (ImGui::BeginCombo("Sampler##RenderSettings", sampler_str[currSampler].c_str())) {
+				for (int i = 0; i < 4; i++) {
+					bool selected = currSampler == i;
+					if (ImGui::Selectable((sampler_str[i] + "##RenderSamplerItem").c_str(), &selected)) {
+						rs.Sampler = RenderSettings::SamplerType(i);
+						currSampler = i;
+					}
+				}
+				ImGui::EndCombo();
+			}
+			ImGui::Checkbox("Light Sampling##RenderSettings", &rs.LightSampling);
+			ImGui::Checkbox("Light BVH##RenderSettings", &rs.LightBVH);
+			ImGui::Checkbox("ReSTIR##RenderSettings", &rs.Restir);
+			if (rs.Restir) {
+				float floatStep = 1;
+				ImGui::InputScalar("ReSTIR Candidates", ImGuiDataType_U32, &rs.RestirCandidates, &intStep, NULL, "%u");
+				ImGui::InputScalar("ReSTIR Neighbors", ImGuiDataType_U32, &rs.RestirNeighbors, &intStep, NULL, "%u");
+				ImGui::InputScalar("ReSTIR Radius", ImGuiDataType_Float, &rs.RestirRadius, &floatStep, NULL);
+			}
+			ImGui::InputScalar("Roulette Depth", ImGuiDataType_U32, &rs.RussianRouletteDepth, &intStep, NULL, "%u");
+			ImGui::Checkbox("Adaptive Sampling##RenderSettings", &rs.AdaptiveSampling);
+			if (rs.AdaptiveSampling) {
+				ImGui::InputScalar("Min Samples", ImGuiDataType_U32, &rs.MinSamples, &intStep, NULL, "%u");
+				ImGui::InputScalar("Max Samples", ImGuiDataType_U32, &rs.MaxSamples, &intStep, NULL, "%u");
+			}
+			else {
+				ImGui::Checkbox("Progressive##RenderSettings", &rs.Progressive);
+				if (rs.Progressive) {
+					ImGui::InputScalar("Samples/Pass", ImGuiDataType_U32, &rs.PassSamples, &intStep, NULL, "%u");
+				}
+			}
 		}
 	}
 	void SceneView::ambientSetting() {
@@ -132,6 +132,24 @@ namespace NRenderer
             }
             ImGui::EndCombo();
         }
+        // 渲染器输出了多个通道时选择显示哪一个
+        auto channels = getServer().screen.getChannelMask();
+        if (viewType == ViewType::RESULT && channels != channelBit(Channel::COLOR)) {
+            ImGui::SameLine();
+            auto selected = getServer().screen.getSelected();
+            if (!hasChannel(channels, selected)) selected = Channel::COLOR;
+            ImGui::SetNextItemWidth(120);
+            if (ImGui::BeginCombo("##Channel", channelName(selected))) {
+                for (unsigned int c = 0; c < CHANNEL_NUMS; c++) {
+                    if (!hasChannel(channels, Channel(c))) continue;
+                    bool isSelected = selected == Channel(c);
+                    if (ImGui::Selectable(channelName(Channel(c)), &isSelected)) {
+                        getServer().screen.select(Channel(c));
+                    }
+                }
+                ImGui::EndCombo();
+            }
+        }
         if (viewType == ViewType::PREVIEW) {
             ImGui::SameLine();
             if (previewCoordinateType == CoordinateType::LEFT_HANDED) {
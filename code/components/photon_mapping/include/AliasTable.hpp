@@ -0,0 +1,77 @@
+#pragma once
+#ifndef __ALIAS_TABLE_HPP__
+#define __ALIAS_TABLE_HPP__
+
+#include <vector>
+#include <algorithm>
+
+namespace PhotonMapping
+{
+    using namespace std;
+
+    // Vose别名表, 按权重O(1)采样离散分布
+    class AliasTable
+    {
+    private:
+        vector<float> prob;
+        vector<size_t> alias;
+        vector<float> pdfs;
+    public:
+        AliasTable() = default;
+        explicit AliasTable(const vector<float>& weights) {
+            build(weights);
+        }
+
+        // 权重全为0时表为空
+        void build(const vector<float>& weights) {
+            size_t n = weights.size();
+            prob.assign(n, 0.f);
+            alias.assign(n, 0);
+            pdfs.assign(n, 0.f);
+            double sum = 0;
+            for (auto w : weights) sum += max(w, 0.f);
+            if (sum <= 0) {
+                prob.clear(); alias.clear(); pdfs.clear();
+                return;
+            }
+            vector<double> scaled(n);
+            vector<size_t> small, large;
+            for (size_t i = 0; i < n; i++) {
+                pdfs[i] = float(max(weights[i], 0.f) / sum);
+                scaled[i] = max(weights[i], 0.f) / sum * n;
+                (scaled[i] < 1 ? small : large).push_back(i);
+            }
+            while (!small.empty() && !large.empty()) {
+                size_t s = small.back(); small.pop_back();
+                size_t l = large.back(); large.pop_back();
+                prob[s] = float(scaled[s]);
+                alias[s] = l;
+                scaled[l] = scaled[l] + scaled[s] - 1;
+                (scaled[l] < 1 ? small : large).push_back(l);
+            }
+            // 剩下的只差浮点误差
+            for (auto i : large) prob[i] = 1;
+            for (auto i : small) prob[i] = 1;
+        }
+
+        bool empty() const {
+            return prob.empty();
+        }
+
+        size_t size() const {
+            return prob.size();
+        }
+
+        float pdf(size_t i) const {
+            return pdfs[i];
+        }
+
+        // u0, u1 均匀分布在 [0, 1)
+        size_t sample(float u0, float u1) const {
+            size_t i = min(size_t(u0 * prob.size()), prob.size() - 1);
+            return u1 < prob[i] ? i : alias[i];
+        }
+    };
+}
+
+#endif
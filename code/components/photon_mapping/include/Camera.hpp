@@ -5,8 +5,6 @@
 #include "scene/Camera.hpp"
 #include "geometry/vec.hpp"
 
-#include "samplers/SamplerInstance.hpp"
-
 #include "Ray.hpp"
 
 namespace PhotonMapping
@@ -48,11 +46,12 @@ namespace PhotonMapping
             vertical = 2*halfHeight*focusDis*v;
         }
 
-        // 从摄像机中发射光线
-        Ray shoot(float s, float t) const {
-            auto r = defaultSamplerInstance<UniformInCircle>().sample2d();
-            float rx = r.x * lenRadius;
-            float ry = r.y * lenRadius;
+        // 从摄像机中发射光线, lens为[0, 1)^2上的样本, 映射到镜头圆盘上
+        Ray shoot(float s, float t, const Vec2& lens) const {
+            float radius = sqrt(lens.x) * lenRadius;
+            float phi = 2 * 3.1415926535898f * lens.y;
+            float rx = radius * cos(phi);
+            float ry = radius * sin(phi);
             Vec3 offset = u*rx + v*ry;
             return Ray{
                 position + offset,
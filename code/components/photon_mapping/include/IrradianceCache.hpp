@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __IRRADIANCE_CACHE_HPP__
+#define __IRRADIANCE_CACHE_HPP__
+
+#include "geometry/vec.hpp"
+
+#include <vector>
+#include <memory>
+#include <shared_mutex>
+#include <atomic>
+
+namespace PhotonMapping
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // Ward 式辐照度缓存, 记录保存在松散八叉树中
+    // 权重 w = 1 / (|p - pi| / Ri + sqrt(1 - n·ni)), w > 1/accuracy 的记录参与插值
+    class IrradianceCache
+    {
+    public:
+        struct Record
+        {
+            Vec3 position;
+            Vec3 normal;
+            RGB irradiance;
+            // 到周围几何体的调和平均距离
+            float radius;
+        };
+    private:
+        struct Node
+        {
+            Vec3 center;
+            float halfSize;
+            vector<Record> records;
+            unique_ptr<Node> children[8];
+        };
+        unique_ptr<Node> root;
+        float accuracy;
+        mutable shared_mutex mtx;
+        mutable atomic<size_t> lookups;
+        mutable atomic<size_t> hits;
+        size_t recordNums;
+
+        bool lookupHelper(const Node* node, const Vec3& position, const Vec3& normal, RGB& sum, float& weightSum) const;
+    public:
+        IrradianceCache();
+        ~IrradianceCache() = default;
+
+        void init(const Vec3& boundMin, const Vec3& boundMax, float accuracy);
+        // 成功插值时返回true
+        bool lookup(const Vec3& position, const Vec3& normal, RGB& irradiance) const;
+        void insert(const Record& record);
+
+        size_t size() const;
+        size_t lookupNums() const;
+        size_t hitNums() const;
+    };
+}
+
+#endif
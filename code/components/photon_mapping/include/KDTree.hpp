@@ -0,0 +1,293 @@
+#pragma once
+#ifndef __KD_TREE_HPP__
+#define __KD_TREE_HPP__
+
+#include "geometry/vec.hpp"
+
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <cstdint>
+
+namespace PhotonMapping
+{
+	using namespace NRenderer;
+	using namespace std;
+
+	// 光子类定义
+	class Photon {
+	public:
+		Vec3 position;
+		Vec3 direction;
+		Vec3 power;
+		Photon() {}
+		Photon(Vec3 pos, Vec3 dir, Vec3 power)
+			: position(pos), direction(dir), power(power) {}
+	};
+
+	// 预计算辐照度的光子(Christensen): 所在表面的法线和该处的辐照度, 单独建树
+	struct IrradiancePhoton {
+		Vec3 position;
+		Vec3 normal;
+		RGB irradiance;
+	};
+
+	// 节点保存在连续数组中, nodes[i]对应建树后的photons[i]
+	// 区间[begin, end)的根是 (begin + end - 1) / 2, 左右子树分别是两侧的区间
+	// 节点只保存光子的下标, 建树用的photons在树的生命周期内不能修改或重新分配
+	// T为带position成员的光子类型
+	template <typename T>
+	class KDTreeOf {
+	public:
+		struct Node {
+			uint32_t photon;
+			int32_t left;
+			int32_t right;
+			uint32_t axis;
+			Vec3 boundary_min;
+			Vec3 boundary_max;
+		};
+
+		KDTreeOf() : nodes(), photonArray(nullptr), root(-1)
+		{
+
+		}
+		KDTreeOf(const KDTreeOf&) = delete;
+		KDTreeOf& operator=(const KDTreeOf&) = delete;
+		// vector移动时缓冲区不变, photonArray仍然有效
+		KDTreeOf(KDTreeOf&& other) noexcept : nodes(std::move(other.nodes)), photonArray(other.photonArray), root(other.root) {
+			other.photonArray = nullptr;
+			other.root = -1;
+		}
+		KDTreeOf& operator=(KDTreeOf&& other) noexcept {
+			if (this != &other) {
+				nodes = std::move(other.nodes);
+				photonArray = other.photonArray;
+				root = other.root;
+				other.photonArray = nullptr;
+				other.root = -1;
+			}
+			return *this;
+		}
+		~KDTreeOf() = default;
+
+		// 建树后photons按中位数划分排列, 数组本身就是一棵隐式平衡树
+		// 上面几层的子树分给不同线程, threads为0时使用硬件线程数
+		void buildTree(vector<T>& photons, unsigned int threads = 0) {
+			build(photons, true, threads);
+		}
+
+		// photons已经是buildTree之后的排列(例如从文件读入), 跳过nth_element
+		void buildTreeOrdered(vector<T>& photons, unsigned int threads = 0) {
+			build(photons, false, threads);
+		}
+
+		bool hasTree() const {
+			return root >= 0;
+		}
+
+		// maxDistSqr限制搜索半径, 半径内不足k个光子时只返回找到的部分
+		// visited不为空时累加访问过的节点数
+		// epsilon > 0 时为近似搜索: 返回的第i近光子距离不超过真实第i近距离的 (1 + epsilon) 倍
+		tuple<vector<T>, float> search(const Vec3& target, size_t k,
+			float maxDistSqr = numeric_limits<float>::max(), size_t* visited = nullptr, float epsilon = 0.f) const {
+			vector<Neighbor> result;
+			result.reserve(k);
+			float shrink = 1.f / ((1.f + epsilon) * (1.f + epsilon));
+			searchHelper(root, target, k, maxDistSqr, shrink, result, visited);
+			if (result.empty()) return { vector<T>{}, 0.f };
+			vector<T> res_p;
+			res_p.reserve(result.size());
+			// result是最大堆, 堆顶就是第k近的距离
+			float res_dist = result.front().distanceSqr;
+			for (auto& item : result)
+			{
+				res_p.push_back(*item.p);
+			}
+			return{ res_p, res_dist };
+		}
+
+		// 满足accept的最近光子, 没有时返回nullptr
+		template<typename F>
+		const T* nearest(const Vec3& target, F&& accept) const {
+			const T* best = nullptr;
+			float bestDist = numeric_limits<float>::max();
+			nearestHelper(root, target, accept, best, bestDist);
+			return best;
+		}
+
+		// 对半径内的所有光子调用f, 用节点包围盒剪枝
+		template<typename F>
+		void forEachInRadius(const Vec3& target, float radius2, F&& f) const {
+			forEachInRadiusHelper(root, target, radius2, f);
+		}
+
+	private:
+		vector<Node> nodes;
+		const T* photonArray;
+		int32_t root;
+
+		// 小于这个规模的子树不再拆分到新线程
+		constexpr static size_t parallelThreshold = 1 << 14;
+
+		struct Neighbor {
+			float distanceSqr;
+			const T* p;
+
+			bool operator<(const Neighbor& other) const {
+				return distanceSqr < other.distanceSqr;
+			}
+		};
+
+		void build(vector<T>& photons, bool partition, unsigned int threads) {
+			nodes.clear();
+			photonArray = nullptr;
+			root = -1;
+			if (photons.empty()) return;
+			if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+			photonArray = photons.data();
+			nodes.resize(photons.size());
+			root = buildTree(photons, 0, photons.size(), 0, partition, threads);
+		}
+
+		int32_t buildTree(vector<T>& photons, size_t begin, size_t end, size_t depth, bool partition, unsigned int threads) {
+			if (begin >= end) {
+				return -1;
+			}
+
+			uint32_t axis = depth % 3;
+			size_t mid = (begin + end - 1) / 2;
+
+			if (partition && end - begin > 1) {
+				nth_element(photons.begin() + begin, photons.begin() + mid, photons.begin() + end,
+					[axis](const T& a, const T& b) {
+						return a.position[axis] < b.position[axis];
+					});
+			}
+
+			// nodes已经分配好, 不同线程只写各自区间内的节点
+			Node& node = nodes[mid];
+			node.photon = uint32_t(mid);
+			node.axis = axis;
+			if (threads > 1 && end - begin > parallelThreshold) {
+				thread t([&, threads]() {
+					node.left = buildTree(photons, begin, mid, depth + 1, partition, threads / 2);
+				});
+				node.right = buildTree(photons, mid + 1, end, depth + 1, partition, threads - threads / 2);
+				t.join();
+			}
+			else {
+				node.left = buildTree(photons, begin, mid, depth + 1, partition, 1);
+				node.right = buildTree(photons, mid + 1, end, depth + 1, partition, 1);
+			}
+
+			node.boundary_min = node.boundary_max = photons[mid].position;
+			for (auto child : { node.left, node.right }) {
+				if (child < 0) continue;
+				node.boundary_min = glm::min(node.boundary_min, nodes[child].boundary_min);
+				node.boundary_max = glm::max(node.boundary_max, nodes[child].boundary_max);
+			}
+			return int32_t(mid);
+		}
+
+		template<typename F>
+		void nearestHelper(int32_t index, const Vec3& target, F& accept, const T*& best, float& bestDist) const {
+			if (index < 0) {
+				return;
+			}
+			auto& node = nodes[index];
+			Vec3 d = glm::max(glm::max(node.boundary_min - target, target - node.boundary_max), Vec3{ 0 });
+			if (glm::dot(d, d) >= bestDist) {
+				return;
+			}
+			auto& p = photonArray[node.photon];
+			Vec3 diff = p.position - target;
+			float dist = glm::dot(diff, diff);
+			if (dist < bestDist && accept(p)) {
+				best = &p;
+				bestDist = dist;
+			}
+			if (target[node.axis] <= p.position[node.axis]) {
+				nearestHelper(node.left, target, accept, best, bestDist);
+				nearestHelper(node.right, target, accept, best, bestDist);
+			}
+			else {
+				nearestHelper(node.right, target, accept, best, bestDist);
+				nearestHelper(node.left, target, accept, best, bestDist);
+			}
+		}
+
+		template<typename F>
+		void forEachInRadiusHelper(int32_t index, const Vec3& target, float radius2, F& f) const {
+			if (index < 0) {
+				return;
+			}
+			auto& node = nodes[index];
+			Vec3 d = glm::max(glm::max(node.boundary_min - target, target - node.boundary_max), Vec3{ 0 });
+			if (glm::dot(d, d) > radius2) {
+				return;
+			}
+			auto& p = photonArray[node.photon];
+			Vec3 diff = p.position - target;
+			if (glm::dot(diff, diff) <= radius2) {
+				f(p);
+			}
+			forEachInRadiusHelper(node.left, target, radius2, f);
+			forEachInRadiusHelper(node.right, target, radius2, f);
+		}
+
+		void searchHelper(int32_t index, const Vec3& target, size_t k, float maxDistSqr, float shrink,
+			vector<Neighbor>& result, size_t* visited) const {
+			if (index < 0 || k == 0) {
+				return;
+			}
+			if (visited != nullptr) {
+				(*visited)++;
+			}
+			auto& node = nodes[index];
+			auto& p = photonArray[node.photon];
+
+			Vec3 diff = p.position - target;
+			float dist = glm::dot(diff, diff);
+			if (dist < maxDistSqr) {
+				if (result.size() < k) {
+					result.push_back({ dist, &p });
+					push_heap(result.begin(), result.end());
+				}
+				else if (dist < result.front().distanceSqr) {
+					pop_heap(result.begin(), result.end());
+					result.back() = { dist, &p };
+					push_heap(result.begin(), result.end());
+				}
+			}
+			// 找满k个之前只能用maxDistSqr剪枝, 之后按 (1 + epsilon) 缩小当前第k近的距离
+			auto bound = [&]() {
+				return result.size() < k ? maxDistSqr : min(maxDistSqr, result.front().distanceSqr * shrink);
+			};
+
+			float axisDist = target[node.axis] - p.position[node.axis];
+
+			if (axisDist <= 0) {
+				searchHelper(node.left, target, k, maxDistSqr, shrink, result, visited);
+				if (node.right >= 0) {
+					axisDist = target[node.axis] - nodes[node.right].boundary_min[node.axis];
+					if (axisDist * axisDist < bound())
+						searchHelper(node.right, target, k, maxDistSqr, shrink, result, visited);
+				}
+			}
+			else {
+				searchHelper(node.right, target, k, maxDistSqr, shrink, result, visited);
+				if (node.left >= 0) {
+					axisDist = target[node.axis] - nodes[node.left].boundary_max[node.axis];
+					if (axisDist * axisDist < bound())
+						searchHelper(node.left, target, k, maxDistSqr, shrink, result, visited);
+				}
+			}
+		}
+	};
+	using KDTree = KDTreeOf<Photon>;
+}
+
+#endif
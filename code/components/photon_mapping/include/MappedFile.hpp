@@ -0,0 +1,37 @@
+#pragma once
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <string>
+
+namespace PhotonMapping
+{
+    using namespace std;
+
+    // 只读的内存映射文件
+    class MappedFile
+    {
+    private:
+        const char* ptr;
+        size_t length;
+        void* fileHandle;
+        void* mappingHandle;
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const string& path);
+        void close();
+
+        const char* data() const {
+            return ptr;
+        }
+        size_t size() const {
+            return length;
+        }
+    };
+}
+
+#endif
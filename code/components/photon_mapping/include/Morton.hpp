@@ -0,0 +1,30 @@
+#pragma once
+#ifndef __MORTON_HPP__
+#define __MORTON_HPP__
+
+#include "geometry/vec.hpp"
+
+#include <cstdint>
+
+namespace PhotonMapping
+{
+    using namespace NRenderer;
+
+    // 把10位整数的每一位之间插入两个0
+    inline uint32_t expandBits(uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    // 点在包围盒内的30位Morton码, 码值相近的点在空间上也相近
+    inline uint32_t mortonCode(const Vec3& p, const Vec3& boundMin, const Vec3& boundMax) {
+        Vec3 extent = glm::max(boundMax - boundMin, Vec3{ 1e-6f });
+        Vec3 n = glm::clamp((p - boundMin) / extent, Vec3{ 0.f }, Vec3{ 1.f }) * 1023.f;
+        return (expandBits(uint32_t(n.x)) << 2) | (expandBits(uint32_t(n.y)) << 1) | expandBits(uint32_t(n.z));
+    }
+}
+
+#endif
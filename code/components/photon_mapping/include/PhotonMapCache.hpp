@@ -0,0 +1,70 @@
+#pragma once
+#ifndef __PHOTON_MAP_CACHE_HPP__
+#define __PHOTON_MAP_CACHE_HPP__
+
+#include "PhotonMapping.hpp"
+
+#include <mutex>
+#include <cstdint>
+
+namespace PhotonMapping
+{
+    using namespace std;
+
+    // 光子图与视点无关, 只改变摄像机或分辨率时可以直接复用
+    // 内存中只保留最近一次的光子图; 也可以保存为文件, 之后通过内存映射读入
+    class PhotonMapCache
+    {
+    public:
+        struct Entry
+        {
+            uint64_t key = 0;
+            PhotonMap global;
+            PhotonMap caustic;
+            IrradianceMap irradiance;
+        };
+
+        // FNV-1a
+        class Hasher
+        {
+        private:
+            uint64_t h = 14695981039346656037ull;
+        public:
+            void add(const void* data, size_t size) {
+                auto bytes = (const unsigned char*)data;
+                for (size_t i = 0; i < size; i++) {
+                    h ^= bytes[i];
+                    h *= 1099511628211ull;
+                }
+            }
+            template<typename T>
+            void add(const T& v) {
+                add(&v, sizeof(T));
+            }
+            void add(const string& s) {
+                add(s.data(), s.size());
+            }
+            uint64_t value() const {
+                return h;
+            }
+        };
+    private:
+        mutex mtx;
+        bool valid;
+        Entry entry;
+        PhotonMapCache() : valid(false) {}
+    public:
+        static PhotonMapCache& instance();
+
+        // 命中时把光子图移动到out中, 渲染结束后再用put放回
+        bool take(uint64_t key, Entry& out);
+        void put(Entry&& in);
+
+        static string filePath(uint64_t key);
+        static bool save(const string& path, const Entry& in);
+        // threads为重建树的线程数
+        static bool load(const string& path, uint64_t key, Entry& out, unsigned int threads);
+    };
+}
+
+#endif
@@ -6,6 +6,16 @@
 #include "Ray.hpp"
 #include "Camera.hpp"
 #include "intersections/HitRecord.hpp"
+#include "KDTree.hpp"
+#include "IrradianceCache.hpp"
+#include "ProjectionMap.hpp"
+#include "AliasTable.hpp"
+#include "PhotonSpill.hpp"
+#include "samplers/Halton.hpp"
+#include "utilities/TileScheduler.hpp"
+#include "utilities/Random.hpp"
+#include "utilities/Denoiser.hpp"
+#include "utilities/LightTree.hpp"
 
 #include "shaders/ShaderCreator.hpp"
 
@@ -16,151 +26,26 @@
 #include <vector>
 #include <algorithm>
 #include <list>
+#include <atomic>
 namespace PhotonMapping
 {
 	using namespace NRenderer;
 	using namespace std;
 
-	// 光子类定义
-	class Photon {
-	public:
-		Vec3 position;
-		Vec3 direction;
-		Vec3 power;
-		Photon() {}
-		Photon(Vec3 pos, Vec3 dir, Vec3 power)
-			: position(pos), direction(dir), power(power) {}
-	};
-
-	class KDTree {
-	public:
-		struct Node {
-			Photon p;
-			Node* left;
-			Node* right;
-			size_t axis;
-			Vec3 boundary_min;
-			Vec3 boundary_max;
-
-			Node(Photon& p, const size_t& axis) : p(p), left(nullptr), right(nullptr), axis(axis) {}
-		};
-
-		KDTree() :root(nullptr)
-		{
-
-		}
-
-		void buildTree(vector<Photon>& photons) {
-			root = buildTree(photons, 0, photons.size() - 1, 0);
-		}
-
-		~KDTree() {
-			destroyTree(root);
-		}
-
-		tuple<vector<Photon>, float> search(const Vec3& target, size_t k) {
-			list<Neighbor> result;
-			searchHelper(root, target, k, result);
-			vector<Photon> res_p;
-			float res_dist = result.back().distanceSqr;
-			for (auto item : result)
-			{
-				res_p.push_back(item.p);
-			}
-			return{ res_p, res_dist };
-		}
-
-	private:
-		Node* root;
-
-		struct Neighbor {
-			float distanceSqr;
-			Photon p;
-
-			bool operator<(const Neighbor& other) const {
-				return distanceSqr < other.distanceSqr;
-			}
-		};
-
-		Node* buildTree(vector<Photon>& photons, size_t start, size_t end, size_t depth) {
-			if (start > end) {
-				return nullptr;
-			}
-
-			else if (start == end) {
-				Node* node = new Node(photons[start], depth % 3);
-				node->boundary_min = node->boundary_max = photons[start].position;
-				return node;
-			}
-
-			size_t axis = depth % 3;
-			size_t mid = (start + end) / 2;
-
-			/*cout << start << " " << mid << " " << end << endl;*/
-
-			nth_element(photons.begin() + start, photons.begin() + mid, photons.begin() + end + 1,
-				[axis](Photon& a, Photon& b) {
-					return a.position[axis] < b.position[axis];
-				});
-
-			Node* newNode = new Node(photons[mid], axis);
-			newNode->left = buildTree(photons, start, mid < 1 ? 0 : mid - 1, depth + 1);
-			newNode->right = buildTree(photons, mid + 1, end, depth + 1);
-
-			float float_min = numeric_limits<float>::lowest(), float_max = numeric_limits<float>::max();
-			Vec3 min1 = newNode->left == nullptr ? Vec3(float_max, float_max, float_max) : newNode->left->boundary_min;
-			Vec3 min2 = newNode->right == nullptr ? Vec3(float_max, float_max, float_max) : newNode->right->boundary_min;
-			newNode->boundary_min = glm::min(glm::min(min1, min2), photons[mid].position);
-			Vec3 max1 = newNode->left == nullptr ? Vec3(float_min, float_min, float_min) : newNode->left->boundary_max;
-			Vec3 max2 = newNode->right == nullptr ? Vec3(float_min, float_min, float_min) : newNode->right->boundary_max;
-			newNode->boundary_max = glm::max(glm::max(max1, max2), photons[mid].position);
-
-			return newNode;
-		}
-
-		void destroyTree(Node* node) {
-			if (node == nullptr) {
-				return;
-			}
-
-			destroyTree(node->left);
-			destroyTree(node->right);
+	// 光子和对应的KD树; 超出内存预算时光子写出到spill, photons和tree为空
+	struct PhotonMap {
+		vector<Photon> photons;
+		KDTree tree;
+		shared_ptr<PhotonSpill> spill;
 
-			delete node;
+		size_t size() const {
+			return spill ? spill->size() : photons.size();
 		}
+	};
 
-		void searchHelper(Node* node, const Vec3& target, size_t k, list<Neighbor>& result) {
-			if (node == nullptr) {
-				return;
-			}
-
-			auto neighbor = Neighbor(glm::dot(((node->p).position - target), ((node->p).position - target)), node->p);
-
-			result.insert(lower_bound(result.begin(), result.end(), neighbor), neighbor);
-
-			if (result.size() > k) {
-				result.pop_back();
-			}
-
-			float axisDist = target[node->axis] - ((node->p).position)[node->axis];
-
-			if (axisDist <= 0) {
-				searchHelper(node->left, target, k, result);
-				if (node->right != nullptr) {
-					axisDist = target[node->axis] - (node->right->boundary_min)[node->axis];
-					if (axisDist * axisDist < result.back().distanceSqr)
-						searchHelper(node->right, target, k, result);
-				}
-			}
-			else {
-				searchHelper(node->right, target, k, result);
-				if (node->left != nullptr) {
-					axisDist = target[node->axis] - (node->left->boundary_max)[node->axis];
-					if (axisDist * axisDist < result.back().distanceSqr)
-						searchHelper(node->left, target, k, result);
-				}
-			}
-		}
+	struct IrradianceMap {
+		vector<IrradiancePhoton> photons;
+		KDTreeOf<IrradiancePhoton> tree;
 	};
 
 	class PhotonMappingRenderer
@@ -170,15 +55,105 @@ namespace PhotonMapping
 		SharedScene spScene;
 		Scene& scene;
 
-		// 
-		vector<Photon> photons;
+		// 全局光子图不保存焦散路径(LS+D)的光子, 焦散光子只向镜面/透射物体发射, 单独保存
+		PhotonMap globalMap;
+		PhotonMap causticMap;
+		enum class PhotonMapType { GLOBAL, CAUSTIC };
 		// todo ： 从UI传进来
 		unsigned int photonsPerLight;
+		// 大于0时忽略photonsPerLight, 光子总数固定并按光源功率分配
+		unsigned int photonBudget;
 		float russianRoulette;
 		unsigned int neighborsNum;
+		// 近似k近邻的误差上界, 0为精确搜索
+		float knnEpsilon;
+		unsigned int causticPhotonsPerLight;
+		unsigned int causticNeighborsNum;
+		bool causticMapEnabled;
+		// 每个面光源一张投影图, 光子只朝能打到几何体的方向发射
+		bool projectionMapsEnabled;
+		vector<ProjectionMap> projectionMaps;
+		// 光源上的位置、发射方向和光源选择取自Halton序列的各维, 下标为光子序号
+		bool qmcEmission;
+		Halton halton;
+		uint64_t photonSequence;
+
+		// 直接光照: 按功率选择光源, 在光源上均匀取点并发射阴影光线
+		// 不做final gathering时全局光子图不保存从光源直接到达的光子
+		bool directLighting;
+		unsigned int shadowRays;
+		AliasTable lightTable;
+		// 光源层次结构: 按着色点选择光源, 也用于光线与光源求交; 关闭时使用lightTable
+		bool lightBVH;
+		LightTree lightTree;
+		bool storeDirectPhotons;
+
+		// final gathering
+		bool finalGather;
+		unsigned int gatherRays;
+		float irradianceCacheAccuracy;
+		IrradianceCache irradianceCache;
+		// 缓存记录半径的上下限, 由场景尺寸决定
+		float gatherRadiusMin;
+		float gatherRadiusMax;
+
+		// 预计算辐照度的光子(Christensen), 发射时每irradiancePhotonStride个全局光子记录一个位置和表面法线
+		bool precomputeIrradiance;
+		IrradianceMap irradianceMap;
+		constexpr static unsigned int irradiancePhotonStride = 4;
+
+		// 光子图缓存, 同时保存到临时文件
+		bool savePhotonMap;
+
+		// 光子图的内存预算(字节), 0为不限制; 每个光子按光子本身加一个树节点计算
+		// 先扣除焦散光子图, 剩余的给全局光子图(和预计算辐照度的光子), 全局光子图在内存中最多保存spillLimit个光子
+		size_t photonMemory;
+		size_t spillLimit;
+		size_t spillResidentChunks;
+		// 大于0时预算放不下焦散光子图和每个线程一个分块, spill时会超出预算
+		size_t spillMinimum;
+
+		// 分批gather: 先收集一个块内的漫反射交点, 按Morton码排序后统一做k近邻查询
+		bool batchedGather;
+		struct GatherRequest {
+			HitRecordBase hit;
+			RGB weight;
+			unsigned int pixel;
+			uint32_t code;
+		};
+		struct GatherStats {
+			atomic<size_t> queries{ 0 };
+			atomic<size_t> nodes{ 0 };
+			atomic<size_t> retries{ 0 };
+			atomic<uint64_t> nanoseconds{ 0 };
+		};
+		// 每个漫反射交点的光子图估计, 分批与否都记录, 用来比较两种模式的吞吐量
+		GatherStats gatherStats;
+		// 非分批模式下k近邻查询访问的节点数
+		GatherStats searchStats;
+
+		// SPPM
+		struct VisiblePoint {
+			Vec3 position;
+			Vec3 normal;
+			RGB weight;
+			bool valid;
+		};
+		struct SPPMPixel {
+			VisiblePoint vp;
+			RGB direct;
+			RGB tau;
+			float radius2;
+			float n;
+		};
+		bool sppm;
+		unsigned int sppmPasses;
+		unsigned int sppmPhotonsPerPass;
+		float sppmInitialRadius;
+		constexpr static float sppmAlpha = 0.7f;
+		vector<SPPMPixel> sppmPixels;
 
 		RenderSettings::Acceleration acc;
-		KDTree kd_tree;
 
 		unsigned int width;
 		unsigned int height;
@@ -190,11 +165,25 @@ namespace PhotonMapping
 
 		vector<SharedShader> shaderPrograms;
 
+		TileScheduler scheduler;
+
+		// 降噪: 每次采样记录首个交点的albedo、法线和深度, 所有采样结束后滤波; SPPM不做
+		bool denoise;
+		unsigned int denoiseIterations;
+		vector<DenoisePixel> denoisePixels;
+
+		// 附加输出通道(AOV_CHANNELS的子集), 每个块按掩码分派到实例化的渲染循环; SPPM不输出
+		unsigned int aovChannels;
+		vector<AovPixel> aovPixels;
+		FrameBuffer aovs;
+
 	public:
 		PhotonMappingRenderer(SharedScene spScene)
 			: spScene(spScene)
 			, scene(*spScene)
 			, camera(spScene->camera)
+			, scheduler(spScene->renderOption.width, spScene->renderOption.height,
+				spScene->renderOption.tileSize, spScene->renderOption.threads)
 		{
 			width = scene.renderOption.width;
 			height = scene.renderOption.height;
@@ -202,30 +191,107 @@ namespace PhotonMapping
 			samples = scene.renderOption.samplesPerPixel;
 			acc = scene.renderOption.acc;
 			photonsPerLight = scene.renderOption.photonsPerLight;
+			photonBudget = scene.renderOption.photonBudget;
 			russianRoulette = 0.8;
 			neighborsNum = scene.renderOption.neighborPhotons;
-			kd_tree = KDTree();
+			knnEpsilon = glm::max(0.f, scene.renderOption.knnEpsilon);
+			sppm = scene.renderOption.sppm;
+			sppmPasses = scene.renderOption.sppmPasses;
+			sppmPhotonsPerPass = scene.renderOption.sppmPhotonsPerPass;
+			sppmInitialRadius = scene.renderOption.sppmInitialRadius;
+			causticPhotonsPerLight = scene.renderOption.causticPhotonsPerLight;
+			causticNeighborsNum = scene.renderOption.causticNeighborPhotons;
+			causticMapEnabled = !sppm && causticPhotonsPerLight > 0;
+			projectionMapsEnabled = scene.renderOption.projectionMaps;
+			qmcEmission = scene.renderOption.qmcEmission;
+			photonSequence = 0;
+			finalGather = scene.renderOption.finalGather;
+			directLighting = !sppm && scene.renderOption.directLighting;
+			shadowRays = scene.renderOption.shadowRays;
+			lightBVH = scene.renderOption.lightBVH;
+			storeDirectPhotons = !directLighting || finalGather;
+			gatherRays = scene.renderOption.gatherRays;
+			irradianceCacheAccuracy = scene.renderOption.irradianceCacheAccuracy;
+			precomputeIrradiance = !sppm && scene.renderOption.precomputeIrradiance;
+			savePhotonMap = scene.renderOption.savePhotonMap;
+			photonMemory = sppm ? 0 : size_t(scene.renderOption.photonMemoryMB) * 1024 * 1024;
+			spillLimit = 0;
+			spillResidentChunks = 1;
+			spillMinimum = 0;
+			batchedGather = !finalGather && scene.renderOption.batchedGather;
+			denoise = scene.renderOption.denoise;
+			denoiseIterations = scene.renderOption.denoiseIterations;
+			aovChannels = scene.renderOption.aovChannels & AOV_CHANNELS;
 		}
 		~PhotonMappingRenderer() = default;
 
 		using RenderResult = tuple<RGBA*, unsigned int, unsigned int>;
 		RenderResult render();
 		void release(const RenderResult& r);
+		// render之后有效, 只包含请求的通道
+		const FrameBuffer& getAovs() const { return aovs; }
 
 	private:
-		void renderTask(RGBA* pixels, int width, int height, int off, int step);
+		void renderTask(RGBA* pixels, const Tile& tile);
+		// Channels为要输出的AOV通道
+		template <unsigned int Channels>
+		void renderTile(RGBA* pixels, const Tile& tile);
 
 		RGB gamma(const RGB& rgb);
-		RGB trace(const Ray& ray, int currDepth);
+		// feature不为空时写入首个交点的特征
+		RGB trace(const Ray& ray, int currDepth, Pcg32& rng, SurfaceFeature* feature = nullptr);
+		void denoiseImage(RGBA* pixels, double renderTime);
 		HitRecord closestHitObject(const Ray& r);
 		tuple<float, Vec3> closestHitLight(const Ray& r);
 
 		//
 		void buildPhotonMap();
+		void planPhotonMemory();
+		void spillGlobalPhotons();
+		uint64_t photonMapKey();
+		void acquirePhotonMap();
+		void releasePhotonMap();
+		void buildProjectionMaps();
+		void emitPhotons(unsigned int perLight);
+		void emitPhotonsByPower(unsigned int total);
+		void emitPhoton(size_t i, float weight, uint64_t index);
+		float emissionSample(uint64_t index, unsigned int dim);
+		float lightPower(size_t i) const;
+		void emitCausticPhotons(unsigned int perLight);
 		void buildPhotonMapTask(int step);
-		void tracePhoton(const Ray& r, Vec3 currPower, int currDepth);
-		tuple<vector<Photon>, float> findNearestPhotons(Vec3& point);
+		void tracePhoton(const Ray& r, Vec3 currPower, int currDepth, PhotonMapType type, bool specularPath, Pcg32& rng);
+		tuple<vector<Photon>, float> findNearestPhotons(PhotonMap& map, const Vec3& point, unsigned int k);
+		RGB estimateRadiance(PhotonMap& map, const HitRecordBase& hit, unsigned int k);
+		RGB radianceFromPhotons(const vector<Photon>& knn, float radius2, const Vec3& normal) const;
+		RGB globalRadiance(const HitRecordBase& hit);
+		void buildIrradiancePhotons();
 		void buildKDTree();
+		bool isDiffuse(Material& material) const;
+		bool isSpecular(Material& material) const;
+		void sceneBounds(Vec3& boundMin, Vec3& boundMax) const;
+
+		// direct lighting
+		void buildLightTable();
+		RGB directRadiance(const HitRecordBase& hit, Pcg32& rng);
+
+		// final gathering
+		RGB gatherIrradiance(const HitRecordBase& hit, int currDepth, Pcg32& rng);
+		RGB gatherSpecular(const Ray& r, int currDepth, RGB throughput, Pcg32& rng);
+
+		// batched gather
+		void renderTaskBatched(RGBA* pixels, const Tile& tile);
+		template <unsigned int Channels>
+		void renderTileBatched(RGBA* pixels, const Tile& tile);
+		RGB traceDeferred(const Ray& r, int currDepth, const RGB& throughput, unsigned int pixel, vector<GatherRequest>& requests, Pcg32& rng, SurfaceFeature* feature = nullptr);
+		RGB batchedRadiance(PhotonMap& map, const HitRecordBase& hit, unsigned int k, float& prevRadius2, size_t& nodes, size_t& retries);
+		void gatherBatch(const vector<GatherRequest>& requests, RGB* colors);
+
+		// SPPM
+		RenderResult renderProgressive();
+		void visiblePointTask(const Tile& tile, unsigned int pass);
+		void traceVisiblePoint(const Ray& r, int currDepth, const RGB& throughput, SPPMPixel& pixel, Pcg32& rng);
+		void gatherTask(const Tile& tile);
+		void resolveTask(RGBA* pixels, unsigned int pass, const Tile& tile);
 	};
 }
 
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __PHOTON_SPILL_HPP__
+#define __PHOTON_SPILL_HPP__
+
+#include "KDTree.hpp"
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <mutex>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+
+namespace PhotonMapping
+{
+    using namespace std;
+
+    // 超出内存预算的光子按Morton码排序, 分块写入临时文件
+    // 查询时按包围盒距离依次访问分块, 分块通过内存映射读入并建树, 只在内存中保留最近使用的若干块
+    // 内存峰值: 发射时为预算加上spill排序用的下标(每个光子8字节)和一个分块的写缓冲;
+    // 归并时只有一个分块的缓冲, 输入文件通过内存映射读入, 占用的是可回收的页缓存;
+    // 渲染时为驻留的分块加上每个线程最多一块正在建树或刚被换出的分块, 由渲染器控制在预算内
+    class PhotonSpill
+    {
+    public:
+        constexpr static size_t chunkPhotons = 1 << 16;
+    private:
+        struct Chunk
+        {
+            size_t offset;
+            size_t count;
+            Vec3 boundMin;
+            Vec3 boundMax;
+        };
+        // 读入内存的分块: 光子的副本和在其上建的树, 树只保存光子的下标
+        struct ResidentChunk
+        {
+            vector<Photon> photons;
+            KDTree tree;
+        };
+        Vec3 sceneMin;
+        Vec3 sceneMax;
+        string path;
+        ofstream out;
+        vector<Chunk> chunks;
+        // 每次spill写出一段按Morton码有序的光子, finish时归并成整体有序
+        vector<pair<size_t, size_t>> runs;
+        size_t photonNums;
+        MappedFile file;
+
+        size_t maxResident;
+        mutable mutex mtx;
+        // 最近使用的分块在前
+        mutable list<size_t> lru;
+        mutable unordered_map<size_t, pair<shared_ptr<const ResidentChunk>, list<size_t>::iterator>> resident;
+        mutable atomic<size_t> pageIns;
+
+        shared_ptr<const ResidentChunk> acquire(size_t chunk) const;
+        void writeChunk(ofstream& stream, const vector<Photon>& buffer, size_t offset);
+        bool mergeRuns();
+    public:
+        PhotonSpill(const Vec3& sceneMin, const Vec3& sceneMax, size_t maxResident);
+        ~PhotonSpill();
+        PhotonSpill(const PhotonSpill&) = delete;
+        PhotonSpill& operator=(const PhotonSpill&) = delete;
+
+        // 写出photons并清空
+        bool spill(vector<Photon>& photons);
+        // 写入结束, 映射文件供查询使用
+        bool finish();
+
+        tuple<vector<Photon>, float> search(const Vec3& target, size_t k, float epsilon = 0.f, size_t* visited = nullptr) const;
+
+        size_t size() const {
+            return photonNums;
+        }
+        size_t chunkNums() const {
+            return chunks.size();
+        }
+        size_t pageInNums() const {
+            return pageIns;
+        }
+        const string& filePath() const {
+            return path;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef __PROJECTION_MAP_HPP__
+#define __PROJECTION_MAP_HPP__
+
+#include "geometry/vec.hpp"
+
+#include <vector>
+
+namespace PhotonMapping
+{
+    using namespace NRenderer;
+    using namespace std;
+
+    // 光源半球方向上的投影图, 按 (cosθ, φ) 等面积划分
+    // 被标记的格子表示该方向能打到场景几何体, 光子只在标记的格子里均匀发射
+    class ProjectionMap
+    {
+    public:
+        constexpr static unsigned int zRes = 32;
+        constexpr static unsigned int phiRes = 64;
+    private:
+        vector<char> marked;
+        vector<unsigned int> markedCells;
+    public:
+        ProjectionMap();
+        ~ProjectionMap() = default;
+
+        // 局部坐标系(法线为z轴)下, 格子cell内 (u1, u2) 处的方向
+        static Vec3 cellDirection(unsigned int cell, float u1, float u2);
+
+        void mark(unsigned int cell);
+        // 把标记扩大一圈, 弥补构建时漏掉的细小几何体; 同时生成标记格子的列表
+        void finish();
+
+        bool empty() const;
+        // 标记格子占整个半球的比例, 光子功率要乘以这个比例
+        float fraction() const;
+        Vec3 sample(float u0, float u1, float u2) const;
+    };
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef __HALTON_HPP__
+#define __HALTON_HPP__
+
+#include "utilities/Random.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+
+namespace PhotonMapping
+{
+    using namespace std;
+    // 置换(scrambled) Halton 序列, 第dim维以第dim个素数为底做根式反演
+    // 每一维的数字先经过一个固定的随机置换, 打散高维两两之间的相关
+    // 按下标取值, 与调用顺序和线程无关; 置换由PCG驱动的Fisher-Yates生成, 与标准库实现无关
+    class Halton
+    {
+    public:
+        constexpr static unsigned int dimensions = 8;
+    private:
+        constexpr static unsigned int primes[dimensions] = { 2, 3, 5, 7, 11, 13, 17, 19 };
+        vector<unsigned int> permutations[dimensions];
+        // 固定反演的位数, 使 base^digits >= 2^32, 否则高位的0被置换后成为无穷级数, 落在区间端点上
+        unsigned int digits[dimensions];
+    public:
+        explicit Halton(unsigned int seed = 0) {
+            NRenderer::Pcg32 rng{ seed };
+            for (unsigned int d = 0; d < dimensions; d++) {
+                permutations[d].resize(primes[d]);
+                for (unsigned int i = 0; i < primes[d]; i++) permutations[d][i] = i;
+                // std::shuffle的结果随标准库而变, 光子图和缓存的键在不同编译器间不一致
+                for (unsigned int i = primes[d] - 1; i > 0; i--) {
+                    swap(permutations[d][i], permutations[d][rng.nextUInt() % (i + 1)]);
+                }
+                digits[d] = 0;
+                for (double range = 1; range < 4294967296.0; range *= primes[d]) digits[d]++;
+            }
+        }
+
+        // 返回[0, 1)
+        float sample(uint64_t index, unsigned int dim) const {
+            unsigned int base = primes[dim % dimensions];
+            auto& perm = permutations[dim % dimensions];
+            // 反演的结果用整数精确计算, 连乘 1/base 会累积误差
+            uint64_t reversed = 0;
+            uint64_t scale = 1;
+            for (unsigned int i = 0; i < digits[dim % dimensions]; i++) {
+                uint64_t next = index / base;
+                reversed = reversed * base + perm[index - next * base];
+                scale *= base;
+                index = next;
+            }
+            double v = double(reversed) / double(scale);
+            // 转成float后仍在原来的区间内: 高位的0置换成0时v恰好是区间左端点, 向上舍入;
+            // 否则v在区间内部或紧贴右端点, 向下舍入
+            float f = float(v);
+            if (perm[0] == 0) {
+                if (f < v) f = nextafter(f, 1.f);
+            }
+            else if (f > v) {
+                f = nextafter(f, 0.f);
+            }
+            return min(f, NRenderer::ONE_MINUS_EPSILON);
+        }
+    };
+}
+
+#endif
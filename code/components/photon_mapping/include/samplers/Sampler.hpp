@@ -1,27 +0,0 @@
-#pragma once
-#ifndef __SAMPLER_HPP__
-#define __SAMPLER_HPP__
-
-#include <mutex>
-
-namespace PhotonMapping
-{
-    using std::mutex;
-    class Sampler
-    {
-    protected:
-        static int insideSeed() {
-            static mutex m;
-            static int seed = 0;
-            m.lock();
-            seed++;
-            m.unlock();
-            return seed;
-        }
-    public:
-        virtual ~Sampler() = default;
-        Sampler() = default;
-    };
-}
-
-#endif
\ No newline at end of file
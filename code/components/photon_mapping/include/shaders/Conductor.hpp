@@ -3,7 +3,6 @@
 #define __CONDUCTOR_HPP__
 
 #include "Shader.hpp"
-#include "samplers/SamplerInstance.hpp"
 
 namespace PhotonMapping {
 	class Conductor : public Shader {
@@ -12,7 +11,7 @@ namespace PhotonMapping {
 
 	public:
 		Conductor(Material& material, vector<Texture>& textures);
-		Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+		Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const;
 	};
 
 }  // namespace PhotonMapping
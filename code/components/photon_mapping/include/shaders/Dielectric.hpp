@@ -3,7 +3,6 @@
 #define __DIELECTRIC_HPP__
 
 #include "Shader.hpp"
-#include "samplers/SamplerInstance.hpp"
 
 namespace PhotonMapping {
 	class Dielectric : public Shader {
@@ -13,7 +12,7 @@ namespace PhotonMapping {
 
 	public:
 		Dielectric(Material& material, vector<Texture>& textures);
-		Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+		Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const;
 
 		inline float schlick(float cosine, float refractionIndex) const
 		{
@@ -28,7 +27,8 @@ namespace PhotonMapping {
 			return glm::normalize(incident - 2.0f * glm::dot(incident, normal) * normal);
 		}
 
-		Vec3 scatterHelper(Vec3 incident, Vec3 normal, float n1, float n2) const
+		// u为[0, 1)上的样本, 用于在反射和折射之间选择
+		Vec3 scatterHelper(Vec3 incident, Vec3 normal, float n1, float n2, float u) const
 		{
 			float cosi = clamp(glm::dot(incident, normal), -1.f, 1.f);
 			float refractionIndexRatio = n1 / n2;
@@ -53,7 +53,7 @@ namespace PhotonMapping {
 
 			/*cout << r0 << endl;*/
 
-			if (defaultSamplerInstance<UniformSampler>().sample1d() < r0)
+			if (u < r0)
 			{
 				// Reflect
 				return reflect(incident, normal);
@@ -12,7 +12,7 @@ namespace PhotonMapping
         Vec3 albedo;
     public:
         Lambertian(Material& material, vector<Texture>& textures);
-        Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+        Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const;
     };
 }
 
@@ -25,7 +25,8 @@ namespace PhotonMapping
             : material              (material)
             , textureBuffer         (textures)
         {}
-        virtual Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const = 0;
+        // sample为[0, 1)^2上的样本, 由调用者的随机数流提供
+        virtual Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const = 0;
     };
     SHARE(Shader);
 }
@@ -18,6 +18,7 @@ namespace PhotonMapping
             auto renderResult = renderer.render();
             auto [ pixels, width, height ]  = renderResult;
             getServer().screen.set(pixels, width, height);
+            getServer().screen.setChannels(renderer.getAovs());
             renderer.release(renderResult);
         }
     };
@@ -0,0 +1,150 @@
+#include "server/Server.hpp"
+
+#include "PhotonMapping.hpp"
+
+#include "Morton.hpp"
+
+#include <chrono>
+
+namespace PhotonMapping
+{
+	// 分批gather
+	// 每个块为一批; 第一阶段追踪摄像机光线, 只记录漫反射交点和权重; 第二阶段按Morton码排序, 连续的查询落在KD树的同一区域
+	// 排序后相邻查询的k近邻半径接近, 用上一次的半径作为搜索上界, 不足k个光子时再做一次无上界的搜索
+	void PhotonMappingRenderer::renderTaskBatched(RGBA* pixels, const Tile& tile) {
+		dispatchAovs(aovChannels, [this, pixels, &tile]<unsigned int Channels>() { renderTileBatched<Channels>(pixels, tile); });
+	}
+
+	template <unsigned int Channels>
+	void PhotonMappingRenderer::renderTileBatched(RGBA* pixels, const Tile& tile) {
+		Vec3 boundMin, boundMax;
+		sceneBounds(boundMin, boundMax);
+
+		int tileWidth = tile.x1 - tile.x0;
+		int tileHeight = tile.y1 - tile.y0;
+		// 降噪时按采样分开累加, 否则按像素
+		unsigned int slots = denoise ? samples : 1;
+		vector<RGB> colors(size_t(tileWidth) * tileHeight * slots, RGB{ 0 });
+		vector<SurfaceFeature> features(denoise ? colors.size() : 0);
+		vector<GatherRequest> requests;
+
+		for (int r = 0; r < tileHeight; r++) {
+			int i = tile.y0 + r;
+			for (int c = 0; c < tileWidth; c++) {
+				int j = tile.x0 + c;
+				AovTimer<Channels> timer;
+				for (int k = 0; k < samples; k++) {
+					unsigned int index = (r * tileWidth + c) * slots + (denoise ? k : 0);
+					// 与renderTask使用相同的随机数流
+					Pcg32 rng{ hashValues(i * width + j, k) };
+					auto s = rng.next2d();
+					float x = (float(j) + s.x) / float(width);
+					float y = (float(i) + s.y) / float(height);
+					if (!denoise && (Channels & FEATURE_CHANNELS) == 0) {
+						if constexpr (Channels != 0) aovPixels[i * width + j].add<Channels>(SurfaceFeature{});
+						colors[index] += traceDeferred(camera.shoot(x, y, rng.next2d()), 0, RGB{ 1 }, index, requests, rng);
+						continue;
+					}
+					SurfaceFeature feature{};
+					colors[index] += traceDeferred(camera.shoot(x, y, rng.next2d()), 0, RGB{ 1 }, index, requests, rng, &feature);
+					if (denoise) features[index] = feature;
+					if constexpr (Channels != 0) aovPixels[i * width + j].add<Channels>(feature);
+				}
+				if constexpr (Channels != 0) timer.stop(aovPixels[i * width + j]);
+			}
+		}
+
+		// 第二阶段按Morton码跨像素执行, 时间平均分给块内的像素
+		AovTimer<Channels> gatherTimer;
+		for (auto& q : requests) {
+			q.code = mortonCode(q.hit.hitPoint, boundMin, boundMax);
+		}
+		sort(requests.begin(), requests.end(), [](const GatherRequest& a, const GatherRequest& b) {
+			return a.code < b.code;
+		});
+		gatherBatch(requests, colors.data());
+		AovPixel gatherTime{};
+		gatherTimer.stop(gatherTime);
+
+		for (int r = 0; r < tileHeight; r++) {
+			int i = tile.y0 + r;
+			for (int c = 0; c < tileWidth; c++) {
+				RGB color{ 0 };
+				for (unsigned int k = 0; k < slots; k++) {
+					unsigned int index = (r * tileWidth + c) * slots + k;
+					color += colors[index];
+					if (denoise) denoisePixels[i * width + tile.x0 + c].add(colors[index], features[index]);
+				}
+				color = gamma(color / float(samples));
+				pixels[(height - i - 1) * width + tile.x0 + c] = { color, 1 };
+				if constexpr (hasChannel(Channels, Channel::RENDER_TIME))
+					aovPixels[i * width + tile.x0 + c].microseconds += gatherTime.microseconds / double(tileWidth * tileHeight);
+			}
+		}
+	}
+
+	void PhotonMappingRenderer::gatherBatch(const vector<GatherRequest>& requests, RGB* colors) {
+		size_t nodes = 0, retries = 0;
+		// 半径为0表示不设上界
+		float globalRadius2 = 0, causticRadius2 = 0;
+		auto t0 = chrono::steady_clock::now();
+		for (auto& q : requests) {
+			RGB radiance = precomputeIrradiance
+				? globalRadiance(q.hit)
+				: batchedRadiance(globalMap, q.hit, neighborsNum, globalRadius2, nodes, retries);
+			if (causticMapEnabled)
+				radiance += batchedRadiance(causticMap, q.hit, causticNeighborsNum, causticRadius2, nodes, retries);
+			colors[q.pixel] += q.weight * radiance;
+		}
+		gatherStats.nanoseconds += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+		gatherStats.queries += requests.size();
+		gatherStats.nodes += nodes;
+		gatherStats.retries += retries;
+	}
+
+	// 与trace相同, 但漫反射表面的光子图估计推迟到第二阶段, 返回值只包含直接看到的光源
+	RGB PhotonMappingRenderer::traceDeferred(const Ray& r, int currDepth, const RGB& throughput, unsigned int pixel, vector<GatherRequest>& requests, Pcg32& rng, SurfaceFeature* feature) {
+		if (currDepth == depth) return throughput * scene.ambient.constant;
+		auto hitObject = closestHitObject(r);
+		auto [t, emitted] = closestHitLight(r);
+		if (hitObject && hitObject->t < t) {
+			auto mtlHandle = hitObject->material;
+			auto& material = scene.materials[mtlHandle.index()];
+			if (isDiffuse(material))
+			{
+				auto c = material.getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
+				if (currDepth == 0 && feature != nullptr) *feature = { c, hitObject->normal, hitObject->t, int(mtlHandle.index()) };
+				requests.push_back({ *hitObject, throughput * c, pixel, 0 });
+				// 直接光照不需要查询光子图, 在第一阶段算完
+				return directLighting ? throughput * c * directRadiance(*hitObject, rng) : Vec3{ 0 };
+			}
+			else if (isSpecular(material))
+			{
+				if (currDepth == 0 && feature != nullptr) *feature = { RGB{ 1 }, hitObject->normal, hitObject->t, int(mtlHandle.index()) };
+				auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal, rng.next2d());
+				return traceDeferred(scattered.ray, currDepth + 1, throughput * scattered.attenuation, pixel, requests, rng);
+			}
+			else
+				assert(0);
+		}
+		else if (t != FLOAT_INF) {
+			return throughput * emitted;
+		}
+		return Vec3{ 0 };
+	}
+
+	RGB PhotonMappingRenderer::batchedRadiance(PhotonMap& map, const HitRecordBase& hit, unsigned int k, float& prevRadius2, size_t& nodes, size_t& retries) {
+		if (map.size() == 0 || k == 0) return Vec3{ 0 };
+		if (map.spill || acc != RenderSettings::Acceleration::KD_TREE) return estimateRadiance(map, hit, k);
+		auto result = prevRadius2 > 0
+			? map.tree.search(hit.hitPoint, k, 2.f * prevRadius2, &nodes, knnEpsilon)
+			: map.tree.search(hit.hitPoint, k, numeric_limits<float>::max(), &nodes, knnEpsilon);
+		if (prevRadius2 > 0 && get<0>(result).size() < k && get<0>(result).size() < map.photons.size()) {
+			retries++;
+			result = map.tree.search(hit.hitPoint, k, numeric_limits<float>::max(), &nodes, knnEpsilon);
+		}
+		auto& [knn, radius2] = result;
+		prevRadius2 = radius2;
+		return radianceFromPhotons(knn, radius2, hit.normal);
+	}
+}
@@ -0,0 +1,105 @@
+#include "IrradianceCache.hpp"
+
+#include <mutex>
+#include <cfloat>
+
+namespace PhotonMapping
+{
+    IrradianceCache::IrradianceCache()
+        : root              (nullptr)
+        , accuracy          (0.2f)
+        , mtx               ()
+        , lookups           (0)
+        , hits              (0)
+        , recordNums        (0)
+    {}
+
+    void IrradianceCache::init(const Vec3& boundMin, const Vec3& boundMax, float accuracy) {
+        unique_lock lock{ mtx };
+        this->accuracy = accuracy;
+        root = make_unique<Node>();
+        root->center = (boundMin + boundMax) * 0.5f;
+        auto extent = boundMax - boundMin;
+        root->halfSize = glm::max(glm::max(extent.x, extent.y), extent.z) * 0.5f + 0.001f;
+        recordNums = 0;
+        lookups = 0;
+        hits = 0;
+    }
+
+    // 松散八叉树: 节点的查询范围是中心 ± 2*halfSize, 因此影响半径不超过halfSize的记录都能被找到
+    bool IrradianceCache::lookupHelper(const Node* node, const Vec3& position, const Vec3& normal, RGB& sum, float& weightSum) const {
+        for (auto& r : node->records) {
+            auto d = position - r.position;
+            float dist = glm::length(d);
+            // 记录在当前点前方时不使用
+            if (glm::dot(d, (normal + r.normal) * 0.5f) < -0.05f * r.radius) continue;
+            float e = dist / r.radius + sqrt(glm::max(0.f, 1.f - glm::dot(normal, r.normal)));
+            float w = e > 0 ? 1.f / e : FLT_MAX;
+            if (w > 1.f / accuracy) {
+                sum += w * r.irradiance;
+                weightSum += w;
+            }
+        }
+        for (auto& child : node->children) {
+            if (child == nullptr) continue;
+            auto d = glm::abs(position - child->center);
+            float loose = 2.f * child->halfSize;
+            if (d.x <= loose && d.y <= loose && d.z <= loose) {
+                lookupHelper(child.get(), position, normal, sum, weightSum);
+            }
+        }
+        return weightSum > 0;
+    }
+
+    bool IrradianceCache::lookup(const Vec3& position, const Vec3& normal, RGB& irradiance) const {
+        shared_lock lock{ mtx };
+        lookups++;
+        if (root == nullptr) return false;
+        RGB sum{ 0 };
+        float weightSum = 0;
+        if (!lookupHelper(root.get(), position, normal, sum, weightSum)) return false;
+        hits++;
+        irradiance = sum / weightSum;
+        return true;
+    }
+
+    void IrradianceCache::insert(const Record& record) {
+        unique_lock lock{ mtx };
+        if (root == nullptr) return;
+        // 记录的影响半径为 accuracy * radius
+        float influence = accuracy * record.radius;
+        Node* node = root.get();
+        while (node->halfSize * 0.5f >= influence) {
+            int index = (record.position.x > node->center.x ? 1 : 0)
+                | (record.position.y > node->center.y ? 2 : 0)
+                | (record.position.z > node->center.z ? 4 : 0);
+            auto& child = node->children[index];
+            if (child == nullptr) {
+                float h = node->halfSize * 0.5f;
+                child = make_unique<Node>();
+                child->halfSize = h;
+                child->center = node->center + Vec3{
+                    index & 1 ? h : -h,
+                    index & 2 ? h : -h,
+                    index & 4 ? h : -h
+                };
+            }
+            node = child.get();
+        }
+        node->records.push_back(record);
+        recordNums++;
+    }
+
+    size_t IrradianceCache::size() const {
+        shared_lock lock{ mtx };
+        return recordNums;
+    }
+
+    size_t IrradianceCache::lookupNums() const {
+        return lookups;
+    }
+
+    size_t IrradianceCache::hitNums() const {
+        return hits;
+    }
+}
@@ -0,0 +1,90 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace PhotonMapping
+{
+    MappedFile::MappedFile()
+        : ptr               (nullptr)
+        , length            (0)
+        , fileHandle        (nullptr)
+        , mappingHandle     (nullptr)
+    {}
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::open(const string& path) {
+        close();
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            return false;
+        }
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == NULL) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        fileHandle = file;
+        mappingHandle = mapping;
+        ptr = (const char*)view;
+        length = (size_t)fileSize.QuadPart;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (ptr != nullptr) UnmapViewOfFile(ptr);
+        if (mappingHandle != nullptr) CloseHandle((HANDLE)mappingHandle);
+        if (fileHandle != nullptr) CloseHandle((HANDLE)fileHandle);
+        ptr = nullptr;
+        length = 0;
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+    }
+#else
+    bool MappedFile::open(const string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) return false;
+        ptr = (const char*)view;
+        length = (size_t)st.st_size;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (ptr != nullptr) munmap((void*)ptr, length);
+        ptr = nullptr;
+        length = 0;
+    }
+#endif
+}
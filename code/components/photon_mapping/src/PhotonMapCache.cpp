@@ -0,0 +1,101 @@
+#include "PhotonMapCache.hpp"
+#include "MappedFile.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+namespace PhotonMapping
+{
+    namespace
+    {
+        struct FileHeader
+        {
+            char magic[8];
+            uint64_t key;
+            // global, caustic, irradiance
+            uint64_t counts[3];
+            uint32_t hasTree[3];
+            uint32_t photonSize;
+            uint32_t irradiancePhotonSize;
+        };
+        const char fileMagic[8] = { 'N', 'R', 'P', 'M', 'A', 'P', '2', 0 };
+
+        // 读入一张光子图, 返回下一张的起始位置
+        template <typename T, typename Tree>
+        const char* readMap(const char* src, uint64_t count, bool hasTree, vector<T>& photons, Tree& tree, unsigned int threads) {
+            auto begin = (const T*)src;
+            photons.assign(begin, begin + count);
+            if (hasTree) tree.buildTreeOrdered(photons, threads);
+            else tree = Tree();
+            return src + count * sizeof(T);
+        }
+    }
+
+    PhotonMapCache& PhotonMapCache::instance() {
+        static PhotonMapCache cache{};
+        return cache;
+    }
+
+    bool PhotonMapCache::take(uint64_t key, Entry& out) {
+        lock_guard lock{ mtx };
+        if (!valid || entry.key != key) return false;
+        out = std::move(entry);
+        valid = false;
+        return true;
+    }
+
+    void PhotonMapCache::put(Entry&& in) {
+        lock_guard lock{ mtx };
+        entry = std::move(in);
+        valid = true;
+    }
+
+    string PhotonMapCache::filePath(uint64_t key) {
+        char name[64];
+        snprintf(name, sizeof(name), "NRenderer_photon_map_%016llx.bin", (unsigned long long)key);
+        return (filesystem::temp_directory_path() / name).string();
+    }
+
+    // 光子按建树之后的顺序写入, 读入时不需要重新划分
+    bool PhotonMapCache::save(const string& path, const Entry& in) {
+        FileHeader header{};
+        memcpy(header.magic, fileMagic, sizeof(fileMagic));
+        header.key = in.key;
+        header.photonSize = sizeof(Photon);
+        header.irradiancePhotonSize = sizeof(IrradiancePhoton);
+        header.counts[0] = in.global.photons.size();
+        header.counts[1] = in.caustic.photons.size();
+        header.counts[2] = in.irradiance.photons.size();
+        header.hasTree[0] = in.global.tree.hasTree() ? 1 : 0;
+        header.hasTree[1] = in.caustic.tree.hasTree() ? 1 : 0;
+        header.hasTree[2] = in.irradiance.tree.hasTree() ? 1 : 0;
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out) return false;
+        out.write((const char*)&header, sizeof(header));
+        out.write((const char*)in.global.photons.data(), in.global.photons.size() * sizeof(Photon));
+        out.write((const char*)in.caustic.photons.data(), in.caustic.photons.size() * sizeof(Photon));
+        out.write((const char*)in.irradiance.photons.data(), in.irradiance.photons.size() * sizeof(IrradiancePhoton));
+        return bool(out);
+    }
+
+    bool PhotonMapCache::load(const string& path, uint64_t key, Entry& out, unsigned int threads) {
+        MappedFile file{};
+        if (!file.open(path) || file.size() < sizeof(FileHeader)) return false;
+        FileHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, fileMagic, sizeof(fileMagic)) != 0
+            || header.key != key || header.photonSize != sizeof(Photon)
+            || header.irradiancePhotonSize != sizeof(IrradiancePhoton)) return false;
+        size_t total = sizeof(FileHeader) + (header.counts[0] + header.counts[1]) * sizeof(Photon)
+            + header.counts[2] * sizeof(IrradiancePhoton);
+        if (file.size() < total) return false;
+
+        auto src = file.data() + sizeof(FileHeader);
+        src = readMap(src, header.counts[0], header.hasTree[0] != 0, out.global.photons, out.global.tree, threads);
+        src = readMap(src, header.counts[1], header.hasTree[1] != 0, out.caustic.photons, out.caustic.tree, threads);
+        readMap(src, header.counts[2], header.hasTree[2] != 0, out.irradiance.photons, out.irradiance.tree, threads);
+        out.key = key;
+        return true;
+    }
+}
@@ -8,6 +8,7 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 #include "Onb.hpp"
+#include "PhotonMapCache.hpp"
 
 namespace PhotonMapping
 {
@@ -15,31 +16,52 @@ namespace PhotonMapping
 		return glm::sqrt(rgb);
 	}
 
-	void PhotonMappingRenderer::renderTask(RGBA* pixels, int width, int height, int off, int step) {
-		for (int i = off; i < height; i += step) {
-			for (int j = 0; j < width; j++) {
+	void PhotonMappingRenderer::renderTask(RGBA* pixels, const Tile& tile) {
+		dispatchAovs(aovChannels, [this, pixels, &tile]<unsigned int Channels>() { renderTile<Channels>(pixels, tile); });
+	}
+
+	template <unsigned int Channels>
+	void PhotonMappingRenderer::renderTile(RGBA* pixels, const Tile& tile) {
+		for (int i = tile.y0; i < tile.y1; i++) {
+			for (int j = tile.x0; j < tile.x1; j++) {
+				AovTimer<Channels> timer;
 				Vec3 color{ 0, 0, 0 };
 				for (int k = 0; k < samples; k++) {
-					auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
+					// 每个 (像素, 采样) 一个随机数流, 结果与线程数和块的执行顺序无关
+					Pcg32 rng{ hashValues(i * width + j, k) };
+					auto r = rng.next2d();
 					float rx = r.x;
 					float ry = r.y;
 					float x = (float(j) + rx) / float(width);
 					float y = (float(i) + ry) / float(height);
-					auto ray = camera.shoot(x, y);
-					color += trace(ray, 0);
+					auto ray = camera.shoot(x, y, rng.next2d());
+					if (!denoise && (Channels & FEATURE_CHANNELS) == 0) {
+						if constexpr (Channels != 0) aovPixels[i * width + j].add<Channels>(SurfaceFeature{});
+						color += trace(ray, 0, rng);
+						continue;
+					}
+					SurfaceFeature feature{};
+					auto c = trace(ray, 0, rng, &feature);
+					if (denoise) denoisePixels[i * width + j].add(c, feature);
+					if constexpr (Channels != 0) aovPixels[i * width + j].add<Channels>(feature);
+					color += c;
 				}
+				if constexpr (Channels != 0) timer.stop(aovPixels[i * width + j]);
 				color /= samples;
 				color = gamma(color);
 				pixels[(height - i - 1) * width + j] = { color, 1 };
 			}
-			/*cout << "line " << i << " rendered" << endl;*/
 		}
-		cout << "thread " << off << " ended" << endl;
 	}
 
 	auto PhotonMappingRenderer::render() -> RenderResult {
+		if (sppm) {
+			if (denoise) getServer().logger.warning("Denoise is ignored by SPPM");
+			if (aovChannels != 0) getServer().logger.warning("Output channels other than color are ignored by SPPM");
+			return renderProgressive();
+		}
 
-		cout << "photons/light = " << photonsPerLight << "\tneighborsNum = " << neighborsNum << endl;
+		cout << "photons/light = " << photonsPerLight << "\tphoton budget = " << photonBudget << "\tneighborsNum = " << neighborsNum << endl;
 
 		// shaders
 		shaderPrograms.clear();
@@ -53,23 +75,86 @@ namespace PhotonMapping
 		// 局部坐标转换成世界坐标
 		VertexTransformer vertexTransformer{};
 		vertexTransformer.exec(spScene);
+		// 光子追踪也要与光源求交, 在发射光子之前建立
+		if (lightBVH) {
+			lightTree.build(scene.areaLightBuffer, false);
+		}
 
 		// 
-		buildPhotonMap();
+		acquirePhotonMap();
+		if (directLighting && !lightBVH) {
+			buildLightTable();
+		}
+
+		if (finalGather) {
+			Vec3 boundMin, boundMax;
+			sceneBounds(boundMin, boundMax);
+			irradianceCache.init(boundMin, boundMax, irradianceCacheAccuracy);
+			float diagonal = glm::length(boundMax - boundMin);
+			gatherRadiusMin = 0.001f * diagonal;
+			gatherRadiusMax = 0.1f * diagonal;
+		}
 
-		const auto taskNums = 8;
-		thread t[taskNums];
-		for (int i = 0; i < taskNums; i++) {
-			t[i] = thread(&PhotonMappingRenderer::renderTask,
-				this, pixels, width, height, i, taskNums);
+		if (denoise) denoisePixels.assign(size_t(width) * height, {});
+		if (aovChannels != 0) aovPixels.assign(size_t(width) * height, {});
+		auto start = chrono::steady_clock::now();
+		scheduler.run([this, pixels](const Tile& tile, unsigned int) {
+			if (batchedGather) renderTaskBatched(pixels, tile);
+			else renderTask(pixels, tile);
+		});
+		getServer().logger.log("Tile scheduler: " + scheduler.report());
+		if (denoise) denoiseImage(pixels, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		if (aovChannels != 0) {
+			aovs = FrameBuffer{ width, height, aovChannels };
+			dispatchAovs(aovChannels, [this]<unsigned int Channels>() { writeAovs<Channels>(aovs, aovPixels); });
+			aovPixels.clear();
+			aovPixels.shrink_to_fit();
+		}
+		if (globalMap.spill) {
+			getServer().logger.log("Photon spill: " + to_string(globalMap.spill->pageInNums()) + " chunk page-ins");
 		}
-		for (int i = 0; i < taskNums; i++) {
-			t[i].join();
+		releasePhotonMap();
+		if (searchStats.queries > 0) {
+			getServer().logger.log("kNN search: " + to_string(searchStats.queries) + " queries, "
+				+ to_string(double(searchStats.nodes) / double(searchStats.queries)) + " nodes/query, epsilon "
+				+ to_string(knnEpsilon));
+		}
+		if (gatherStats.queries > 0) {
+			double throughput = gatherStats.nanoseconds > 0 ? double(gatherStats.queries) * 1e9 / double(gatherStats.nanoseconds) : 0.0;
+			if (batchedGather) {
+				getServer().logger.log("Batched gather: " + to_string(gatherStats.queries) + " queries, "
+					+ to_string(throughput) + " queries/s/thread, "
+					+ to_string(double(gatherStats.nodes) / double(gatherStats.queries)) + " nodes/query, "
+					+ to_string(gatherStats.retries) + " bound retries, epsilon " + to_string(knnEpsilon));
+			}
+			else {
+				getServer().logger.log("Unbatched gather: " + to_string(gatherStats.queries) + " queries, "
+					+ to_string(throughput) + " queries/s/thread");
+			}
+		}
+		if (finalGather) {
+			getServer().logger.log("Irradiance cache: " + to_string(irradianceCache.size()) + " records, "
+				+ to_string(irradianceCache.hitNums()) + "/" + to_string(irradianceCache.lookupNums()) + " lookups interpolated");
 		}
 		getServer().logger.log("Done...");
 		return { pixels, width, height };
 	}
 
+	// 所有采样结束后的后处理, 用滤波后的颜色覆盖pixels
+	void PhotonMappingRenderer::denoiseImage(RGBA* pixels, double renderTime) {
+		Denoiser denoiser{ width, height, denoiseIterations, scene.renderOption.threads };
+		auto colors = denoiser.run(denoisePixels);
+		for (int i = 0; i < height; i++) {
+			for (int j = 0; j < width; j++) {
+				pixels[(height - i - 1) * width + j] = { gamma(colors[i * width + j]), 1 };
+			}
+		}
+		getServer().logger.log("Denoise: " + to_string(denoiseIterations) + " iterations in "
+			+ to_string(denoiser.milliseconds()) + "ms, " + to_string(denoiser.milliseconds() / 10 / renderTime) + "% of render time");
+		denoisePixels.clear();
+		denoisePixels.shrink_to_fit();
+	}
+
 	void PhotonMappingRenderer::release(const RenderResult& r) {
 		auto [p, w, h] = r;
 		delete[] p;
@@ -105,6 +190,16 @@ namespace PhotonMapping
 	tuple<float, Vec3> PhotonMappingRenderer::closestHitLight(const Ray& r) {
 		Vec3 v = {};
 		HitRecord closest = getHitRecord(FLOAT_INF, {}, {}, {});
+		if (lightBVH) {
+			lightTree.intersect(r.origin, r.direction, FLOAT_INF, [&](unsigned int i, float tMax) {
+				auto hitRecord = Intersection::xAreaLight(r, scene.areaLightBuffer[i], 0.000001, tMax);
+				if (!hitRecord || hitRecord->t >= tMax) return tMax;
+				closest = hitRecord;
+				v = scene.areaLightBuffer[i].radiance;
+				return hitRecord->t;
+			});
+			return { closest->t, v };
+		}
 		for (auto& a : scene.areaLightBuffer) {
 			auto hitRecord = Intersection::xAreaLight(r, a, 0.000001, closest->t);
 			if (hitRecord && closest->t > hitRecord->t) {
@@ -115,59 +210,447 @@ namespace PhotonMapping
 		return { closest->t, v };
 	}
 
+	bool PhotonMappingRenderer::isDiffuse(Material& material) const {
+		return material.hasProperty("diffuseColor") || material.hasProperty("diffuseMap");
+	}
+
+	bool PhotonMappingRenderer::isSpecular(Material& material) const {
+		return material.hasProperty("ior") || material.hasProperty("reflect");
+	}
+
+	void PhotonMappingRenderer::sceneBounds(Vec3& boundMin, Vec3& boundMax) const {
+		boundMin = Vec3{ FLOAT_INF };
+		boundMax = Vec3{ -FLOAT_INF };
+		auto expand = [&](const Vec3& p) {
+			boundMin = glm::min(boundMin, p);
+			boundMax = glm::max(boundMax, p);
+		};
+		for (auto& s : scene.sphereBuffer) {
+			expand(s.position - Vec3{ s.radius });
+			expand(s.position + Vec3{ s.radius });
+		}
+		for (auto& t : scene.triangleBuffer) {
+			expand(t.v1); expand(t.v2); expand(t.v3);
+		}
+		for (auto& p : scene.planeBuffer) {
+			expand(p.position); expand(p.position + p.u);
+			expand(p.position + p.v); expand(p.position + p.u + p.v);
+		}
+		for (auto& a : scene.areaLightBuffer) {
+			expand(a.position); expand(a.position + a.u);
+			expand(a.position + a.v); expand(a.position + a.u + a.v);
+		}
+		if (boundMin.x > boundMax.x) {
+			boundMin = boundMax = Vec3{ 0 };
+		}
+	}
+
+	// 光子图只和几何, 材质, 光源以及光子相关的设置有关, 与摄像机和分辨率无关
+	uint64_t PhotonMappingRenderer::photonMapKey() {
+		PhotonMapCache::Hasher h{};
+		h.add(photonsPerLight);
+		h.add(causticPhotonsPerLight);
+		h.add(causticMapEnabled);
+		h.add(projectionMapsEnabled);
+		h.add(qmcEmission);
+		h.add(photonBudget);
+		h.add(storeDirectPhotons);
+		h.add(precomputeIrradiance);
+		h.add(precomputeIrradiance ? neighborsNum : 0u);
+		h.add(depth);
+		h.add(acc);
+		for (auto& s : scene.sphereBuffer) {
+			h.add(s.position); h.add(s.radius); h.add(s.material.getValue());
+		}
+		for (auto& t : scene.triangleBuffer) {
+			h.add(t.v1); h.add(t.v2); h.add(t.v3); h.add(t.normal); h.add(t.material.getValue());
+		}
+		for (auto& p : scene.planeBuffer) {
+			h.add(p.normal); h.add(p.position); h.add(p.u); h.add(p.v); h.add(p.material.getValue());
+		}
+		for (auto& m : scene.materials) {
+			h.add(m.type);
+			for (auto& prop : m.properties) {
+				h.add(prop.key);
+				h.add(prop.type);
+				visit([&h](auto& w) { h.add(w.value); }, prop.valueWrapper);
+			}
+		}
+		for (auto& a : scene.areaLightBuffer) {
+			h.add(a.radiance); h.add(a.position); h.add(a.u); h.add(a.v);
+		}
+		return h.value();
+	}
+
+	void PhotonMappingRenderer::acquirePhotonMap() {
+		auto key = photonMapKey();
+		PhotonMapCache::Entry entry{};
+		bool hit = PhotonMapCache::instance().take(key, entry);
+		if (!hit && savePhotonMap) {
+			auto start = chrono::steady_clock::now();
+			hit = PhotonMapCache::load(PhotonMapCache::filePath(key), key, entry, scheduler.threads());
+			if (hit) {
+				getServer().logger.log("Photon map loaded from " + PhotonMapCache::filePath(key) + " in "
+					+ to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()) + "ms");
+			}
+		}
+		if (hit) {
+			globalMap = std::move(entry.global);
+			causticMap = std::move(entry.caustic);
+			irradianceMap = std::move(entry.irradiance);
+			getServer().logger.log("Photon map reused: " + to_string(globalMap.size()) + " global, "
+				+ to_string(causticMap.size()) + " caustic photons");
+			return;
+		}
+		buildPhotonMap();
+		if (savePhotonMap && globalMap.spill) {
+			getServer().logger.warning("Spilled photon maps are not saved");
+		}
+		else if (savePhotonMap) {
+			entry.key = key;
+			entry.global = std::move(globalMap);
+			entry.caustic = std::move(causticMap);
+			entry.irradiance = std::move(irradianceMap);
+			if (!PhotonMapCache::save(PhotonMapCache::filePath(key), entry)) {
+				getServer().logger.warning("Failed to save photon map to " + PhotonMapCache::filePath(key));
+			}
+			globalMap = std::move(entry.global);
+			causticMap = std::move(entry.caustic);
+			irradianceMap = std::move(entry.irradiance);
+		}
+	}
+
+	void PhotonMappingRenderer::releasePhotonMap() {
+		PhotonMapCache::Entry entry{};
+		entry.key = photonMapKey();
+		entry.global = std::move(globalMap);
+		entry.caustic = std::move(causticMap);
+		entry.irradiance = std::move(irradianceMap);
+		PhotonMapCache::instance().put(std::move(entry));
+	}
+
 	void PhotonMappingRenderer::buildPhotonMap()
 	{
+		buildProjectionMaps();
+		photonSequence = 0;
+		// 焦散光子图先建, 它的大小从内存预算中扣除
+		if (causticMapEnabled) {
+			emitCausticPhotons(causticPhotonsPerLight);
+			if (acc == RenderSettings::Acceleration::KD_TREE)
+			{
+				causticMap.tree.buildTree(causticMap.photons, scheduler.threads());
+			}
+			cout << "caustic photon map(size " << causticMap.photons.size() << ") built...\n";
+		}
+		planPhotonMemory();
+		if (spillLimit > 0) {
+			// 一次分配好缓冲区, 按倍数增长会让容量超出预算; 保存的光子数不超过发射数乘以深度
+			size_t emitted = photonBudget > 0 ? photonBudget : size_t(photonsPerLight) * scene.areaLightBuffer.size();
+			globalMap.photons.reserve(min(spillLimit, emitted * depth));
+		}
+		emitPhotons(photonsPerLight);
+		if (globalMap.spill) {
+			spillGlobalPhotons();
+			// 归并和渲染时不再需要缓冲区, 释放后驻留的分块是唯一的大块内存
+			globalMap.photons.shrink_to_fit();
+			if (!globalMap.spill->finish()) {
+				getServer().logger.warning("Failed to map photon spill file " + globalMap.spill->filePath());
+			}
+			getServer().logger.log("Photon spill: " + to_string(globalMap.spill->size()) + " photons in "
+				+ to_string(globalMap.spill->chunkNums()) + " chunks, " + globalMap.spill->filePath());
+			if (precomputeIrradiance) {
+				getServer().logger.warning("Irradiance precomputation is skipped for spilled photon maps");
+				irradianceMap.photons.clear();
+				irradianceMap.photons.shrink_to_fit();
+			}
+		}
+		else if (acc == RenderSettings::Acceleration::KD_TREE || precomputeIrradiance)
+		{
+			auto start = chrono::steady_clock::now();
+			globalMap.tree.buildTree(globalMap.photons, scheduler.threads());
+			getServer().logger.log("KD-tree built in " + to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count())
+				+ "ms on " + to_string(scheduler.threads()) + " threads");
+		}
+		cout << "photon map(size " << globalMap.size() << ") built...\n";
+		if (precomputeIrradiance && !globalMap.spill) {
+			buildIrradiancePhotons();
+		}
+		getServer().logger.log("Photon map: " + to_string(globalMap.size()) + " global, "
+			+ to_string(causticMap.size()) + " caustic photons");
+	}
+
+	// 光子按本身加一个树节点计算, 预计算辐照度时每irradiancePhotonStride个全局光子还要多存一个
+	// spill之后驻留的分块加上每个线程最多一块正在建树或刚被换出的分块都要放在剩余的预算内
+	void PhotonMappingRenderer::planPhotonMemory() {
+		spillLimit = 0;
+		spillResidentChunks = 1;
+		spillMinimum = 0;
+		if (photonMemory == 0) return;
+		const size_t photonBytes = sizeof(Photon) + sizeof(KDTree::Node);
+		size_t causticBytes = causticMap.photons.size() * photonBytes;
+		size_t remaining = photonMemory > causticBytes ? photonMemory - causticBytes : 0;
+		size_t globalBytes = photonBytes
+			+ (precomputeIrradiance ? (sizeof(IrradiancePhoton) + sizeof(KDTree::Node)) / irradiancePhotonStride : 0);
+		spillLimit = max<size_t>(1, remaining / globalBytes);
+		size_t chunkBytes = PhotonSpill::chunkPhotons * photonBytes;
+		size_t chunks = remaining / chunkBytes;
+		if (chunks > scheduler.threads()) {
+			spillResidentChunks = chunks - scheduler.threads();
+		}
+		else {
+			spillMinimum = causticBytes + (scheduler.threads() + 1) * chunkBytes;
+		}
+	}
+
+	void PhotonMappingRenderer::spillGlobalPhotons() {
+		if (!globalMap.spill) {
+			if (spillMinimum > 0) {
+				getServer().logger.warning("Photon memory budget " + to_string(photonMemory >> 20) + "MB is below the "
+					+ to_string((spillMinimum + (1 << 20) - 1) >> 20) + "MB needed for the caustic map and "
+					+ to_string(scheduler.threads() + 1) + " spill chunks, the budget will be exceeded");
+			}
+			Vec3 boundMin, boundMax;
+			sceneBounds(boundMin, boundMax);
+			globalMap.spill = make_shared<PhotonSpill>(boundMin, boundMax, spillResidentChunks);
+		}
+		if (!globalMap.spill->spill(globalMap.photons)) {
+			getServer().logger.warning("Failed to write photon spill file " + globalMap.spill->filePath());
+		}
+	}
+
+	void PhotonMappingRenderer::emitPhotons(unsigned int perLight)
+	{
+		if (photonBudget > 0) {
+			emitPhotonsByPower(photonBudget);
+			return;
+		}
 		// emit photons
-		for (int j = 0; j < photonsPerLight; j++) {
-			for (auto area_light : scene.areaLightBuffer) {
+		for (int j = 0; j < perLight; j++) {
+			for (size_t i = 0; i < scene.areaLightBuffer.size(); i++) {
+				// simplified, 每个光子携带 1/perLight 的光源功率
+				// 每个光源各自使用序列的连续一段, 交替取下标会让各光源只拿到一部分分层
+				emitPhoton(i, 1.f / float(perLight), photonSequence + i * perLight + j);
+			}
+		}
+		photonSequence += uint64_t(perLight) * scene.areaLightBuffer.size();
+	}
 
-				// random pos
-				Vec2 random = defaultSamplerInstance<UniformInSquare>().sample2d();
-				Vec3 origin = area_light.position + random.x * area_light.u + random.y * area_light.v;
+	// 光子总数固定, 按光源功率用别名表选择光源, 每个光子携带相同的功率
+	void PhotonMappingRenderer::emitPhotonsByPower(unsigned int total)
+	{
+		vector<float> weights;
+		for (size_t i = 0; i < scene.areaLightBuffer.size(); i++) {
+			weights.push_back(lightPower(i));
+		}
+		AliasTable lights{ weights };
+		if (lights.empty()) return;
+		for (unsigned int j = 0; j < total; j++) {
+			uint64_t index = photonSequence + j;
+			size_t i = lights.sample(emissionSample(index, 5), emissionSample(index, 6));
+			emitPhoton(i, 1.f / (float(total) * lights.pdf(i)), index);
+		}
+		photonSequence += total;
+	}
+
+	// 第0、1维为光源上的位置, 2~4维为方向, 5、6维选择光源
+	// 不用Halton时对 (下标, 维度) 做哈希, 同样与调用顺序无关
+	float PhotonMappingRenderer::emissionSample(uint64_t index, unsigned int dim) {
+		if (qmcEmission) return halton.sample(index, dim);
+		return toUnitFloat(uint32_t(hashValues(index, dim)));
+	}
 
-				// random dir
-				Vec3 random3d = defaultSamplerInstance<HemiSphere>().sample3d();
-				Vec3 normal = glm::normalize(glm::cross(area_light.u, area_light.v));
-				Vec3 direction = glm::normalize(Onb{ normal }.local(random3d));
+	// 面光源发出的总功率(亮度), 投影图只保留能打到场景的部分
+	float PhotonMappingRenderer::lightPower(size_t i) const {
+		auto& area_light = scene.areaLightBuffer[i];
+		float luminance = glm::dot(area_light.radiance, Vec3{ 0.2126f, 0.7152f, 0.0722f });
+		float power = luminance * glm::length(glm::cross(area_light.u, area_light.v)) * PI;
+		if (projectionMapsEnabled) power *= projectionMaps[i].fraction();
+		return power;
+	}
+
+	void PhotonMappingRenderer::emitPhoton(size_t i, float weight, uint64_t index)
+	{
+		auto& area_light = scene.areaLightBuffer[i];
 
-				// simplified
-				auto power = area_light.radiance * glm::length(glm::cross(area_light.u, area_light.v)) * PI;
+		// random pos, 与xAreaLight和阴影光线一致, 光源为 position + [0, 1]u + [0, 1]v
+		Vec2 random{ emissionSample(index, 0), emissionSample(index, 1) };
+		Vec3 origin = area_light.position + random.x * area_light.u + random.y * area_light.v;
 
-				// trace photons recursively
-				tracePhoton(Ray(origin, direction), power, 0);
+		// random dir, 光源为Lambert发光体, 光子功率为 L cos / pdf
+		Vec3 random3d;
+		float scale = 1;
+		if (projectionMapsEnabled) {
+			// 只在标记的方向内均匀采样: pdf = 1 / (2 PI fraction), 功率为 PI L * fraction * 2cos
+			auto& projectionMap = projectionMaps[i];
+			if (projectionMap.empty()) return;
+			random3d = projectionMap.sample(emissionSample(index, 2), emissionSample(index, 3), emissionSample(index, 4));
+			scale = projectionMap.fraction() * 2 * random3d.z;
+		}
+		else {
+			// 余弦分布: z^2均匀分布, 每个光子的功率相同
+			float z = sqrt(emissionSample(index, 2));
+			float phi = 2 * PI * emissionSample(index, 3);
+			float r = sqrt(glm::max(0.f, 1 - z * z));
+			random3d = { cos(phi) * r, sin(phi) * r, z };
+		}
+		Vec3 normal = glm::normalize(glm::cross(area_light.u, area_light.v));
+		Vec3 direction = glm::normalize(Onb{ normal }.local(random3d));
+
+		auto power = area_light.radiance * glm::length(glm::cross(area_light.u, area_light.v)) * PI * scale * weight;
+
+		// trace photons recursively, 弹射时的随机数按 (光子下标, 光源) 生成
+		Pcg32 rng{ hashValues(index, i), 1 };
+		tracePhoton(Ray(origin, direction), power, 0, PhotonMapType::GLOBAL, false, rng);
+	}
+
+	// 从光源中心和四个角朝每个格子的4个子方向发射测试光线, 打到几何体就标记该格子
+	void PhotonMappingRenderer::buildProjectionMaps() {
+		projectionMaps.clear();
+		if (!projectionMapsEnabled) return;
+		const Vec2 offsets[] = { { 0.5f, 0.5f }, { 0.05f, 0.05f }, { 0.95f, 0.05f }, { 0.05f, 0.95f }, { 0.95f, 0.95f } };
+		const unsigned int cellNums = ProjectionMap::zRes * ProjectionMap::phiRes;
+		float fractionSum = 0;
+		for (auto& area_light : scene.areaLightBuffer) {
+			ProjectionMap projectionMap{};
+			Onb onb{ glm::normalize(glm::cross(area_light.u, area_light.v)) };
+			// 借用渲染的调度器和线程数, 按块的序号把格子平均分成连续的几段, 各段只写自己的格子
+			scheduler.run([&](const Tile& tile, unsigned int) {
+				unsigned int begin = cellNums * tile.index / scheduler.size();
+				unsigned int end = cellNums * (tile.index + 1) / scheduler.size();
+				for (unsigned int cell = begin; cell < end; cell++) {
+					bool hit = false;
+					for (int s = 0; s < 4 && !hit; s++) {
+						Vec3 local = ProjectionMap::cellDirection(cell, (float(s % 2) + 0.5f) / 2, (float(s / 2) + 0.5f) / 2);
+						Vec3 direction = glm::normalize(onb.local(local));
+						for (auto& o : offsets) {
+							Vec3 origin = area_light.position + o.x * area_light.u + o.y * area_light.v;
+							if (closestHitObject(Ray(origin, direction))) {
+								hit = true;
+								break;
+							}
+						}
+					}
+					if (hit) projectionMap.mark(cell);
+				}
+			});
+			projectionMap.finish();
+			fractionSum += projectionMap.fraction();
+			projectionMaps.push_back(std::move(projectionMap));
+		}
+		if (!projectionMaps.empty()) {
+			getServer().logger.log("Projection maps: " + to_string(100.f * fractionSum / projectionMaps.size())
+				+ "% of light directions reach the scene");
+		}
+	}
+
+	void PhotonMappingRenderer::emitCausticPhotons(unsigned int perLight)
+	{
+		// 镜面/透射物体的包围球, 焦散光子只朝这些包围球发射
+		vector<tuple<Vec3, float>> targets;
+		for (auto& s : scene.sphereBuffer) {
+			if (isSpecular(scene.materials[s.material.index()]))
+				targets.push_back({ s.position, s.radius });
+		}
+		for (auto& t : scene.triangleBuffer) {
+			if (isSpecular(scene.materials[t.material.index()])) {
+				Vec3 center = (t.v1 + t.v2 + t.v3) / 3.f;
+				float r = glm::max(glm::max(glm::length(t.v1 - center), glm::length(t.v2 - center)), glm::length(t.v3 - center));
+				targets.push_back({ center, r });
 			}
 		}
-		if (acc == RenderSettings::Acceleration::KD_TREE)
-		{
-			kd_tree.buildTree(photons);
+		for (auto& p : scene.planeBuffer) {
+			if (isSpecular(scene.materials[p.material.index()])) {
+				Vec3 center = p.position + 0.5f * (p.u + p.v);
+				targets.push_back({ center, 0.5f * glm::max(glm::length(p.u + p.v), glm::length(p.u - p.v)) });
+			}
+		}
+		if (targets.empty()) return;
+
+		for (size_t i = 0; i < scene.areaLightBuffer.size(); i++) {
+			auto& area_light = scene.areaLightBuffer[i];
+			Vec3 normal = glm::normalize(glm::cross(area_light.u, area_light.v));
+			float area = glm::length(glm::cross(area_light.u, area_light.v));
+			for (int j = 0; j < perLight; j++) {
+				// 与全局光子相同, 每个光源使用序列的连续一段, 接在已发射的光子之后
+				uint64_t index = photonSequence + i * perLight + j;
+				Vec2 random{ emissionSample(index, 0), emissionSample(index, 1) };
+				Vec3 origin = area_light.position + random.x * area_light.u + random.y * area_light.v;
+
+				// 在某个包围球张成的圆锥内均匀采样方向
+				auto pick = min(size_t(emissionSample(index, 4) * targets.size()), targets.size() - 1);
+				auto [center, radius] = targets[pick];
+				Vec3 axis = center - origin;
+				float dist2 = glm::dot(axis, axis);
+				float cosMax = dist2 > radius * radius ? sqrt(1.f - radius * radius / dist2) : -1.f;
+				float cosTheta = 1.f - emissionSample(index, 2) * (1.f - cosMax);
+				float sinTheta = sqrt(glm::max(0.f, 1.f - cosTheta * cosTheta));
+				float phi = 2 * PI * emissionSample(index, 3);
+				Vec3 direction = glm::normalize(Onb{ glm::normalize(axis) }.local({ cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta }));
+
+				float cosLight = glm::dot(direction, normal);
+				if (cosLight <= 0) continue;
+
+				// 圆锥可能重叠, pdf取所有包含该方向的圆锥的混合
+				float pdf = 0;
+				for (auto& [c, r] : targets) {
+					Vec3 a = c - origin;
+					float d2 = glm::dot(a, a);
+					float cm = d2 > r * r ? sqrt(1.f - r * r / d2) : -1.f;
+					if (glm::dot(direction, a) >= cm * sqrt(d2))
+						pdf += 1.f / (2 * PI * (1.f - cm));
+				}
+				pdf /= float(targets.size());
+
+				auto power = area_light.radiance * area * cosLight / pdf / float(perLight);
+				Pcg32 rng{ hashValues(index, i), 2 };
+				tracePhoton(Ray(origin, direction), power, 0, PhotonMapType::CAUSTIC, false, rng);
+			}
 		}
-		cout << "photon map(size " << photons.size() << ") built...\n";
+		photonSequence += uint64_t(perLight) * scene.areaLightBuffer.size();
 	}
 
-	void PhotonMappingRenderer::tracePhoton(const Ray& r, Vec3 currPower, int currDepth) {
+	void PhotonMappingRenderer::tracePhoton(const Ray& r, Vec3 currPower, int currDepth, PhotonMapType type, bool specularPath, Pcg32& rng) {
 		if (currDepth == depth) return;
 		auto hitObject = closestHitObject(r);
 		auto [t, emitted] = closestHitLight(r);
 		// hit object
 		if (hitObject && hitObject->t < t) {
 			auto mtlHandle = hitObject->material;
-			if (scene.materials[mtlHandle.index()].hasProperty("diffuseColor") || scene.materials[mtlHandle.index()].hasProperty("diffuseMap"))
+			auto& material = scene.materials[mtlHandle.index()];
+			if (isDiffuse(material))
 			{
-				/*cout << currPower * fabs(glm::dot(r.direction, hitObject->normal)) << endl;*/
-				if (glm::dot(r.direction, hitObject->normal) < 0)
-					photons.push_back(Photon(hitObject->hitPoint, r.direction, currPower * fabs(glm::dot(r.direction, hitObject->normal))));
+				// 焦散光子只保存 LS+D 路径, 到达漫反射表面后结束
+				if (type == PhotonMapType::CAUSTIC) {
+					if (specularPath && glm::dot(r.direction, hitObject->normal) < 0)
+						causticMap.photons.push_back(Photon(hitObject->hitPoint, r.direction, currPower));
+					return;
+				}
+				// 光子保存到达的功率, 入射角的余弦已经体现在光子的面密度里
+				if (glm::dot(r.direction, hitObject->normal) < 0 && !(causticMapEnabled && specularPath)
+					&& (storeDirectPhotons || currDepth > 0)) {
+					if (precomputeIrradiance && globalMap.photons.size() % irradiancePhotonStride == 0)
+						irradianceMap.photons.push_back({ hitObject->hitPoint, hitObject->normal, RGB{ 0 } });
+					globalMap.photons.push_back(Photon(hitObject->hitPoint, r.direction, currPower));
+					if (spillLimit > 0 && globalMap.photons.size() >= spillLimit) {
+						spillGlobalPhotons();
+					}
+				}
 			}
-			if (scene.materials[mtlHandle.index()].hasProperty("diffuseColor") || scene.materials[mtlHandle.index()].hasProperty("diffuseMap") ||
-				scene.materials[mtlHandle.index()].hasProperty("ior") || scene.materials[mtlHandle.index()].hasProperty("reflect"))
+			if (isDiffuse(material) || isSpecular(material))
 			{
-				if (defaultSamplerInstance<UniformSampler>().sample1d() < russianRoulette) {
-					auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
+				if (rng.nextFloat() < russianRoulette) {
+					auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal, rng.next2d());
 					auto scatteredRay = scattered.ray;
 					auto attenuation = scattered.attenuation;
 					/*auto emitted = scattered.emitted;*/
-					float n_dot_in = fabs(glm::dot(hitObject->normal, scatteredRay.direction));
 					float pdf = scattered.pdf;
-					tracePhoton(scatteredRay, attenuation * currPower * n_dot_in / pdf / russianRoulette, currDepth + 1);
+					if (pdf <= 0) return;
+					// 漫反射为 BRDF * cos / pdf; 镜面的attenuation已经是完整的权重, 与trace一致
+					RGB weight = isDiffuse(material)
+						? attenuation * fabs(glm::dot(hitObject->normal, scatteredRay.direction)) / pdf
+						: attenuation;
+					bool nextSpecular = !isDiffuse(material) && (currDepth == 0 || specularPath);
+					tracePhoton(scatteredRay, weight * currPower / russianRoulette, currDepth + 1, type, nextSpecular, rng);
 				}
 			}
 		}
@@ -179,44 +662,108 @@ namespace PhotonMapping
 		}
 	}
 
-	RGB PhotonMappingRenderer::trace(const Ray& r, int currDepth) {
+	RGB PhotonMappingRenderer::estimateRadiance(PhotonMap& map, const HitRecordBase& hit, unsigned int k) {
+		if (map.size() == 0 || k == 0) return Vec3{ 0 };
+		auto [knn, radius2] = findNearestPhotons(map, hit.hitPoint, k);
+		/*cout << radius2 << endl;*/
+		return radianceFromPhotons(knn, radius2, hit.normal);
+	}
+
+	// 辐照度 E = flux / (PI r^2), 返回 E / PI, 乘漫反射颜色即为出射辐亮度; 与阴影光线和final gather的约定相同
+	RGB PhotonMappingRenderer::radianceFromPhotons(const vector<Photon>& knn, float radius2, const Vec3& normal) const {
+		Vec3 flux{ 0,0,0 };
+		for (auto& p : knn)
+		{
+			if (glm::dot(p.direction, normal) < 0)
+			{
+				flux += p.power;
+			}
+		}
+		if (radius2 <= 0) return Vec3{ 0 };
+		return flux / (PI * PI * radius2);
+	}
+
+	RGB PhotonMappingRenderer::globalRadiance(const HitRecordBase& hit) {
+		if (precomputeIrradiance) {
+			// 法线方向接近的最近irradiance photon
+			auto p = irradianceMap.tree.nearest(hit.hitPoint, [&hit](const IrradiancePhoton& q) {
+				return glm::dot(q.normal, hit.normal) > 0.9f;
+			});
+			if (p != nullptr) return p->irradiance;
+		}
+		return estimateRadiance(globalMap, hit, neighborsNum);
+	}
+
+	// 在部分光子的位置预先完成k近邻估计, 渲染时只需一次最近邻查询
+	void PhotonMappingRenderer::buildIrradiancePhotons() {
+		auto& irradiancePhotons = irradianceMap.photons;
+		if (globalMap.photons.empty() || neighborsNum == 0) {
+			irradiancePhotons.clear();
+			return;
+		}
+
+		auto start = chrono::steady_clock::now();
+		// 建树只依赖位置, 先建树让相邻的查询在空间上也相邻
+		irradianceMap.tree.buildTree(irradiancePhotons, scheduler.threads());
+		// 借用渲染的调度器和线程数, 按块的序号把光子平均分成连续的几段
+		scheduler.run([this, &irradiancePhotons](const Tile& tile, unsigned int) {
+			size_t begin = irradiancePhotons.size() * tile.index / scheduler.size();
+			size_t end = irradiancePhotons.size() * (tile.index + 1) / scheduler.size();
+			for (size_t j = begin; j < end; j++) {
+				auto& p = irradiancePhotons[j];
+				auto [knn, radius2] = globalMap.tree.search(p.position, neighborsNum);
+				p.irradiance = radianceFromPhotons(knn, radius2, p.normal);
+			}
+		});
+		getServer().logger.log("Irradiance photons: " + to_string(irradiancePhotons.size()) + " precomputed in "
+			+ to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()) + "ms");
+	}
+
+	RGB PhotonMappingRenderer::trace(const Ray& r, int currDepth, Pcg32& rng, SurfaceFeature* feature) {
 		if (currDepth == depth) return scene.ambient.constant;
 		auto hitObject = closestHitObject(r);
 		auto [t, emitted] = closestHitLight(r);
 		// hit object
 		if (hitObject && hitObject->t < t) {
 			auto mtlHandle = hitObject->material;
-			if (scene.materials[mtlHandle.index()].hasProperty("diffuseColor") || scene.materials[mtlHandle.index()].hasProperty("diffuseMap"))
+			auto& material = scene.materials[mtlHandle.index()];
+			if (isDiffuse(material))
 			{
 				// diffuse
-				Vec3 flux{ 0,0,0 }, dir{ 0, 0, 0 };
-				auto [knn, radius2] = findNearestPhotons(hitObject->hitPoint);
-				/*cout << radius2 << endl;*/
-				for (auto& p : knn)
-				{
-					if (glm::dot(p.direction, hitObject->normal) < 0)
-					{
-						flux += p.power;
-						dir -= p.direction;
+				auto c = material.getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
+				if (currDepth == 0 && feature != nullptr) *feature = { c, hitObject->normal, hitObject->t, int(mtlHandle.index()) };
+				RGB radiance{ 0 };
+				if (finalGather) {
+					RGB irradiance;
+					if (!irradianceCache.lookup(hitObject->hitPoint, hitObject->normal, irradiance)) {
+						irradiance = gatherIrradiance(*hitObject, currDepth, rng);
 					}
+					radiance = irradiance / PI;
+					if (causticMapEnabled)
+						radiance += estimateRadiance(causticMap, *hitObject, causticNeighborsNum);
 				}
-				auto n_dot_in = glm::dot(hitObject->normal, glm::normalize(dir));
-
-				//auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
-				//auto scatteredRay = scattered.ray;
-				//auto emitted = scattered.emitted;
-
-				auto c = scene.materials[mtlHandle.index()].getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
-				/*cout << c * n_dot_in * (flux / (PI * radius2 * photonsPerLight)) << endl;*/
-				return /*emitted +*/ c * n_dot_in * (flux / (PI * radius2 * photonsPerLight));
+				else {
+					// 与gatherBatch的统计口径相同: 每个交点一次全局加焦散光子图的估计, 用于比较分批前后的吞吐量
+					auto t0 = chrono::steady_clock::now();
+					radiance = globalRadiance(*hitObject);
+					if (causticMapEnabled)
+						radiance += estimateRadiance(causticMap, *hitObject, causticNeighborsNum);
+					gatherStats.nanoseconds.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count(), memory_order_relaxed);
+					gatherStats.queries.fetch_add(1, memory_order_relaxed);
+				}
+				if (directLighting)
+					radiance += directRadiance(*hitObject, rng);
+				return /*emitted +*/ c * radiance;
 			}
-			else if (scene.materials[mtlHandle.index()].hasProperty("ior") || scene.materials[mtlHandle.index()].hasProperty("reflect"))
+			else if (isSpecular(material))
 			{
 				/*cout << "ior " << mtlHandle.index() << endl;*/
-				auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
+				// 镜面的albedo取1, 反射的内容按法线和深度滤波
+				if (currDepth == 0 && feature != nullptr) *feature = { RGB{ 1 }, hitObject->normal, hitObject->t, int(mtlHandle.index()) };
+				auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal, rng.next2d());
 				auto scatteredRay = scattered.ray;
 				auto attenuation = scattered.attenuation;
-				auto next = trace(scatteredRay, currDepth + 1);
+				auto next = trace(scatteredRay, currDepth + 1, rng);
 				float n_dot_in = glm::dot(hitObject->normal, scatteredRay.direction);
 				float pdf = scattered.pdf;
 				/*cout << attenuation << " " << n_dot_in << " " << pdf << endl;
@@ -235,7 +782,138 @@ namespace PhotonMapping
 		}
 	}
 
-	tuple<vector<Photon>, float> PhotonMappingRenderer::findNearestPhotons(Vec3& point) {
+	void PhotonMappingRenderer::buildLightTable() {
+		vector<float> weights;
+		for (auto& a : scene.areaLightBuffer) {
+			float luminance = glm::dot(a.radiance, Vec3{ 0.2126f, 0.7152f, 0.0722f });
+			weights.push_back(luminance * glm::length(glm::cross(a.u, a.v)));
+		}
+		lightTable.build(weights);
+	}
+
+	// 光源只向 u x v 一侧发光, 与光子发射一致
+	// 返回 E / PI, 和光子图估计、final gather的约定相同
+	RGB PhotonMappingRenderer::directRadiance(const HitRecordBase& hit, Pcg32& rng) {
+		if ((lightBVH ? lightTree.empty() : lightTable.empty()) || shadowRays == 0) return Vec3{ 0 };
+		RGB sum{ 0 };
+		for (unsigned int s = 0; s < shadowRays; s++) {
+			float u0 = rng.nextFloat();
+			float u1 = rng.nextFloat();
+			float su = rng.nextFloat();
+			float sv = rng.nextFloat();
+			int i = -1;
+			float select = 0;
+			if (lightBVH) {
+				tie(i, select) = lightTree.sample(hit.hitPoint, hit.normal, u0);
+				if (i < 0) continue;
+			}
+			else {
+				i = int(lightTable.sample(u0, u1));
+				select = lightTable.pdf(i);
+			}
+			auto& a = scene.areaLightBuffer[i];
+			Vec3 point = a.position + su * a.u + sv * a.v;
+
+			Vec3 toLight = point - hit.hitPoint;
+			float dist2 = glm::dot(toLight, toLight);
+			if (dist2 <= 0) continue;
+			float dist = sqrt(dist2);
+			Vec3 direction = toLight / dist;
+			Vec3 lightNormal = glm::cross(a.u, a.v);
+			float area = glm::length(lightNormal);
+			float cosSurface = glm::dot(hit.normal, direction);
+			float cosLight = -glm::dot(lightNormal / area, direction);
+			if (cosSurface <= 0 || cosLight <= 0) continue;
+
+			auto occluder = closestHitObject(Ray(hit.hitPoint, direction));
+			if (occluder && occluder->t < dist * (1 - 1e-4f)) continue;
+			// 面积采样: pdf = P(light) / area
+			sum += a.radiance * cosSurface * cosLight * area / (dist2 * select);
+		}
+		return sum / (PI * float(shadowRays));
+	}
+
+	// 在半球内按余弦分布发射gather光线, 在交点处查询全局光子图, 结果写入辐照度缓存
+	RGB PhotonMappingRenderer::gatherIrradiance(const HitRecordBase& hit, int currDepth, Pcg32& rng) {
+		Onb onb{ hit.normal };
+		RGB sum{ 0 };
+		float inverseDistSum = 0;
+		unsigned int validNums = 0;
+		for (unsigned int i = 0; i < gatherRays; i++) {
+			float u1 = rng.nextFloat();
+			float u2 = rng.nextFloat();
+			float r = sqrt(u1);
+			Vec3 local{ r * cos(2 * PI * u2), r * sin(2 * PI * u2), sqrt(glm::max(0.f, 1.f - u1)) };
+			Ray ray{ hit.hitPoint, glm::normalize(onb.local(local)) };
+
+			auto hitObject = closestHitObject(ray);
+			auto [t, emitted] = closestHitLight(ray);
+			if (hitObject && hitObject->t < t) {
+				auto& material = scene.materials[hitObject->material.index()];
+				if (isDiffuse(material)) {
+					auto c = material.getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
+					sum += c * globalRadiance(*hitObject);
+				}
+				else {
+					auto scattered = shaderPrograms[hitObject->material.index()]->shade(ray, hitObject->hitPoint, hitObject->normal, rng.next2d());
+					sum += gatherSpecular(scattered.ray, currDepth + 2, scattered.attenuation, rng);
+				}
+				inverseDistSum += 1.f / glm::max(hitObject->t, 0.0001f);
+				validNums++;
+			}
+			else if (t != FLOAT_INF) {
+				// 开启直接光照时光源的贡献已经由阴影光线计算
+				if (!directLighting) sum += emitted;
+				inverseDistSum += 1.f / glm::max(t, 0.0001f);
+				validNums++;
+			}
+		}
+		// 余弦重要性采样: E = PI / N * sum(L)
+		RGB irradiance = gatherRays == 0 ? RGB{ 0 } : sum * PI / float(gatherRays);
+
+		if (validNums > 0) {
+			float radius = glm::clamp(float(validNums) / inverseDistSum, gatherRadiusMin, gatherRadiusMax);
+			irradianceCache.insert({ hit.hitPoint, hit.normal, irradiance, radius });
+		}
+		return irradiance;
+	}
+
+	// gather光线打到镜面后沿镜面路径继续, 到达漫反射表面只查询全局光子图, 不再嵌套final gather
+	RGB PhotonMappingRenderer::gatherSpecular(const Ray& r, int currDepth, RGB throughput, Pcg32& rng) {
+		Ray ray = r;
+		for (; currDepth < depth; currDepth++) {
+			auto hitObject = closestHitObject(ray);
+			auto [t, emitted] = closestHitLight(ray);
+			if (hitObject && hitObject->t < t) {
+				auto& material = scene.materials[hitObject->material.index()];
+				if (isDiffuse(material)) {
+					auto c = material.getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
+					return throughput * c * globalRadiance(*hitObject);
+				}
+				auto scattered = shaderPrograms[hitObject->material.index()]->shade(ray, hitObject->hitPoint, hitObject->normal, rng.next2d());
+				throughput *= scattered.attenuation;
+				ray = scattered.ray;
+			}
+			else if (t != FLOAT_INF) {
+				// 经镜面到达光源的是焦散, 开启焦散光子图时已经由其估计
+				return causticMapEnabled ? RGB{ 0 } : throughput * emitted;
+			}
+			else {
+				return Vec3{ 0 };
+			}
+		}
+		return throughput * scene.ambient.constant;
+	}
+
+	tuple<vector<Photon>, float> PhotonMappingRenderer::findNearestPhotons(PhotonMap& map, const Vec3& point, unsigned int k) {
+		if (map.spill) {
+			size_t nodes = 0;
+			auto result = map.spill->search(point, k, knnEpsilon, &nodes);
+			searchStats.queries.fetch_add(1, memory_order_relaxed);
+			searchStats.nodes.fetch_add(nodes, memory_order_relaxed);
+			return result;
+		}
+		auto& photons = map.photons;
 		switch (acc)
 		{
 		case RenderSettings::Acceleration::NONE:
@@ -244,15 +922,14 @@ namespace PhotonMapping
 			for (int i = 0; i != photons.size(); i++)
 			{
 				q.push({ glm::dot(photons[i].position - point, photons[i].position - point), i });
-				/*if (q.size() > neighborsNum)
+				/*if (q.size() > k)
 					q.pop();*/
 			}
 			vector<Photon> res;
 			float radius2 = 0;
-			for (int i = 0; i < neighborsNum && i < photons.size() && !q.empty(); i++)
+			for (int i = 0; i < k && i < photons.size() && !q.empty(); i++)
 			{
-				if (i == neighborsNum - 1)
-					radius2 = q.top().first;
+				radius2 = q.top().first;
 				res.push_back(photons[q.top().second]);
 				q.pop();
 			}
@@ -260,10 +937,14 @@ namespace PhotonMapping
 		}
 		case RenderSettings::Acceleration::KD_TREE:
 		{
-			return kd_tree.search(point, neighborsNum);
+			size_t nodes = 0;
+			auto result = map.tree.search(point, k, numeric_limits<float>::max(), &nodes, knnEpsilon);
+			searchStats.queries.fetch_add(1, memory_order_relaxed);
+			searchStats.nodes.fetch_add(nodes, memory_order_relaxed);
+			return result;
 		}
 		default:
 			assert(0);
 		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,192 @@
+#include "PhotonSpill.hpp"
+#include "Morton.hpp"
+
+#include <filesystem>
+#include <cstdio>
+#include <queue>
+#include <tuple>
+
+namespace PhotonMapping
+{
+    PhotonSpill::PhotonSpill(const Vec3& sceneMin, const Vec3& sceneMax, size_t maxResident)
+        : sceneMin          (sceneMin)
+        , sceneMax          (sceneMax)
+        , path              ()
+        , out               ()
+        , chunks            ()
+        , runs              ()
+        , photonNums        (0)
+        , file              ()
+        , maxResident       (max<size_t>(maxResident, 1))
+        , mtx               ()
+        , lru               ()
+        , resident          ()
+        , pageIns           (0)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "NRenderer_photon_spill_%p.bin", (void*)this);
+        path = (filesystem::temp_directory_path() / name).string();
+        out.open(path, ios::binary | ios::trunc);
+    }
+
+    PhotonSpill::~PhotonSpill() {
+        file.close();
+        out.close();
+        error_code ec;
+        filesystem::remove(path, ec);
+    }
+
+    bool PhotonSpill::spill(vector<Photon>& photons) {
+        if (!out) return false;
+        // 只排序下标, 避免再复制一份光子
+        vector<pair<uint32_t, uint32_t>> order(photons.size());
+        for (size_t i = 0; i < photons.size(); i++) {
+            order[i] = { mortonCode(photons[i].position, sceneMin, sceneMax), uint32_t(i) };
+        }
+        sort(order.begin(), order.end());
+        runs.push_back({ photonNums, order.size() });
+        vector<Photon> buffer;
+        buffer.reserve(min(chunkPhotons, photons.size()));
+        for (size_t begin = 0; begin < order.size(); begin += chunkPhotons) {
+            size_t count = min(chunkPhotons, order.size() - begin);
+            buffer.clear();
+            for (size_t i = begin; i < begin + count; i++) {
+                buffer.push_back(photons[order[i].second]);
+            }
+            writeChunk(out, buffer, photonNums);
+            photonNums += count;
+        }
+        photons.clear();
+        return bool(out);
+    }
+
+    // 排序后连续的一段在空间上是紧凑的, 每段单独记录包围盒
+    void PhotonSpill::writeChunk(ofstream& stream, const vector<Photon>& buffer, size_t offset) {
+        Chunk chunk{ offset * sizeof(Photon), buffer.size(), buffer[0].position, buffer[0].position };
+        for (auto& p : buffer) {
+            chunk.boundMin = glm::min(chunk.boundMin, p.position);
+            chunk.boundMax = glm::max(chunk.boundMax, p.position);
+        }
+        stream.write((const char*)buffer.data(), buffer.size() * sizeof(Photon));
+        chunks.push_back(chunk);
+    }
+
+    // 多路归并各次spill的有序段, 否则每一段都覆盖整个场景, 分块的包围盒互相重叠
+    bool PhotonSpill::mergeRuns() {
+        if (!file.open(path)) return false;
+        string mergedPath = path + ".merged";
+        ofstream merged{ mergedPath, ios::binary | ios::trunc };
+        if (!merged) return false;
+
+        auto photons = (const Photon*)file.data();
+        auto code = [&](size_t i) {
+            return mortonCode(photons[i].position, sceneMin, sceneMax);
+        };
+        // (Morton码, 当前位置, 段号)
+        using Head = tuple<uint32_t, size_t, size_t>;
+        priority_queue<Head, vector<Head>, greater<Head>> heads;
+        for (size_t r = 0; r < runs.size(); r++) {
+            if (runs[r].second > 0) heads.push({ code(runs[r].first), runs[r].first, r });
+        }
+        chunks.clear();
+        vector<Photon> buffer;
+        buffer.reserve(chunkPhotons);
+        size_t written = 0;
+        while (!heads.empty()) {
+            auto [c, i, r] = heads.top();
+            heads.pop();
+            buffer.push_back(photons[i]);
+            if (i + 1 < runs[r].first + runs[r].second) heads.push({ code(i + 1), i + 1, r });
+            if (buffer.size() == chunkPhotons || heads.empty()) {
+                writeChunk(merged, buffer, written);
+                written += buffer.size();
+                buffer.clear();
+            }
+        }
+        merged.close();
+        file.close();
+        error_code ec;
+        filesystem::rename(mergedPath, path, ec);
+        if (ec) return false;
+        runs = { { 0, photonNums } };
+        return bool(merged);
+    }
+
+    bool PhotonSpill::finish() {
+        out.close();
+        if (photonNums == 0) return true;
+        if (runs.size() > 1 && !mergeRuns()) return false;
+        return file.open(path);
+    }
+
+    shared_ptr<const PhotonSpill::ResidentChunk> PhotonSpill::acquire(size_t chunk) const {
+        {
+            lock_guard lock{ mtx };
+            auto it = resident.find(chunk);
+            if (it != resident.end()) {
+                lru.splice(lru.begin(), lru, it->second.second);
+                return it->second.first;
+            }
+        }
+        // 建树不持有锁, 两个线程同时读入同一块时保留先插入的那棵
+        auto& c = chunks[chunk];
+        auto begin = (const Photon*)(file.data() + c.offset);
+        auto loaded = make_shared<ResidentChunk>();
+        loaded->photons.assign(begin, begin + c.count);
+        loaded->tree.buildTree(loaded->photons, 1);
+        pageIns++;
+
+        lock_guard lock{ mtx };
+        auto it = resident.find(chunk);
+        if (it != resident.end()) {
+            lru.splice(lru.begin(), lru, it->second.second);
+            return it->second.first;
+        }
+        lru.push_front(chunk);
+        resident[chunk] = { loaded, lru.begin() };
+        while (resident.size() > maxResident) {
+            resident.erase(lru.back());
+            lru.pop_back();
+        }
+        return loaded;
+    }
+
+    tuple<vector<Photon>, float> PhotonSpill::search(const Vec3& target, size_t k, float epsilon, size_t* visited) const {
+        if (file.data() == nullptr || k == 0) return { vector<Photon>{}, 0.f };
+        // 按包围盒距离从近到远访问分块
+        vector<pair<float, size_t>> order(chunks.size());
+        for (size_t i = 0; i < chunks.size(); i++) {
+            Vec3 d = glm::max(glm::max(chunks[i].boundMin - target, target - chunks[i].boundMax), Vec3{ 0 });
+            order[i] = { glm::dot(d, d), i };
+        }
+        sort(order.begin(), order.end());
+
+        // 最大堆, 堆顶是当前第k近的光子
+        vector<pair<float, Photon>> heap;
+        auto less = [](const pair<float, Photon>& a, const pair<float, Photon>& b) { return a.first < b.first; };
+        float shrink = 1.f / ((1.f + epsilon) * (1.f + epsilon));
+        for (auto& [boxDist, i] : order) {
+            if (heap.size() == k && boxDist >= heap.front().first * shrink) break;
+            auto loaded = acquire(i);
+            float bound = heap.size() == k ? heap.front().first : numeric_limits<float>::max();
+            auto [knn, radius2] = loaded->tree.search(target, k, bound, visited, epsilon);
+            for (auto& p : knn) {
+                float dist = glm::dot(p.position - target, p.position - target);
+                if (heap.size() < k) {
+                    heap.push_back({ dist, p });
+                    push_heap(heap.begin(), heap.end(), less);
+                }
+                else if (dist < heap.front().first) {
+                    pop_heap(heap.begin(), heap.end(), less);
+                    heap.back() = { dist, p };
+                    push_heap(heap.begin(), heap.end(), less);
+                }
+            }
+        }
+        if (heap.empty()) return { vector<Photon>{}, 0.f };
+        vector<Photon> result;
+        result.reserve(heap.size());
+        for (auto& [dist, p] : heap) result.push_back(p);
+        return { result, heap.front().first };
+    }
+}
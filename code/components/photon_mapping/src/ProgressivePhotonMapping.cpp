@@ -0,0 +1,143 @@
+#include "server/Server.hpp"
+
+#include "PhotonMapping.hpp"
+
+#include "VertexTransformer.hpp"
+#include "intersections/intersections.hpp"
+
+namespace PhotonMapping
+{
+	// 随机渐进式光子映射(SPPM)
+	// 每一轮: 从摄像机找到每个像素的可见点 -> 发射固定数量的光子并建树 -> 可见点收集半径内的光子, 收缩半径
+	// 光子图只保存当前一轮的光子, 内存不随轮数增长
+	auto PhotonMappingRenderer::renderProgressive() -> RenderResult {
+		cout << "SPPM passes = " << sppmPasses << "\tphotons/light/pass = " << sppmPhotonsPerPass << endl;
+
+		// shaders
+		shaderPrograms.clear();
+		ShaderCreator shaderCreator{};
+		for (auto& m : scene.materials) {
+			shaderPrograms.push_back(shaderCreator.create(m, scene.textures));
+		}
+
+		RGBA* pixels = new RGBA[width * height]{};
+
+		// 局部坐标转换成世界坐标
+		VertexTransformer vertexTransformer{};
+		vertexTransformer.exec(spScene);
+		if (lightBVH) {
+			lightTree.build(scene.areaLightBuffer, false);
+		}
+
+		SPPMPixel init{};
+		init.radius2 = sppmInitialRadius * sppmInitialRadius;
+		sppmPixels.assign(width * height, init);
+		// 设置了光子总数时, 每一轮发射photonBudget个光子
+		globalMap.photons.reserve(photonBudget > 0 ? photonBudget : sppmPhotonsPerPass * scene.areaLightBuffer.size());
+
+
+		buildProjectionMaps();
+		// 每一轮接着上一轮的下标发射, 各轮的光子不重复
+		photonSequence = 0;
+		getServer().control.setStoppable(true);
+		for (unsigned int pass = 1; pass <= sppmPasses; pass++) {
+			scheduler.run([this, pass](const Tile& tile, unsigned int) { visiblePointTask(tile, pass); });
+
+			globalMap.photons.clear();
+			emitPhotons(sppmPhotonsPerPass);
+			globalMap.tree.buildTree(globalMap.photons, scheduler.threads());
+
+			scheduler.run([this](const Tile& tile, unsigned int) { gatherTask(tile); });
+			scheduler.run([this, pixels, pass](const Tile& tile, unsigned int) { resolveTask(pixels, pass, tile); });
+
+			getServer().screen.set(pixels, width, height);
+			getServer().logger.log("SPPM pass " + to_string(pass) + "/" + to_string(sppmPasses)
+				+ ", photons: " + to_string(globalMap.photons.size()));
+			if (getServer().control.stopRequested()) {
+				getServer().logger.warning("SPPM stopped after pass " + to_string(pass));
+				break;
+			}
+		}
+
+		globalMap.photons.clear();
+		globalMap.photons.shrink_to_fit();
+		globalMap.tree.buildTree(globalMap.photons);
+		sppmPixels.clear();
+		sppmPixels.shrink_to_fit();
+
+		getServer().logger.log("Done...");
+		return { pixels, width, height };
+	}
+
+	void PhotonMappingRenderer::visiblePointTask(const Tile& tile, unsigned int pass) {
+		for (int i = tile.y0; i < tile.y1; i++) {
+			for (int j = tile.x0; j < tile.x1; j++) {
+				auto& pixel = sppmPixels[(height - i - 1) * width + j];
+				pixel.vp.valid = false;
+				// 每轮每个像素一个随机数流
+				Pcg32 rng{ hashValues(i * width + j, pass) };
+				auto r = rng.next2d();
+				float x = (float(j) + r.x) / float(width);
+				float y = (float(i) + r.y) / float(height);
+				traceVisiblePoint(camera.shoot(x, y, rng.next2d()), 0, Vec3{ 1 }, pixel, rng);
+			}
+		}
+	}
+
+	void PhotonMappingRenderer::traceVisiblePoint(const Ray& r, int currDepth, const RGB& throughput, SPPMPixel& pixel, Pcg32& rng) {
+		if (currDepth == depth) return;
+		auto hitObject = closestHitObject(r);
+		auto [t, emitted] = closestHitLight(r);
+		if (hitObject && hitObject->t < t) {
+			auto mtlHandle = hitObject->material;
+			auto& material = scene.materials[mtlHandle.index()];
+			if (isDiffuse(material))
+			{
+				auto c = material.getProperty<Property::Wrapper::RGBType>("diffuseColor")->value;
+				pixel.vp = { hitObject->hitPoint, hitObject->normal, throughput * c, true };
+			}
+			else if (isSpecular(material))
+			{
+				auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal, rng.next2d());
+				traceVisiblePoint(scattered.ray, currDepth + 1, throughput * scattered.attenuation, pixel, rng);
+			}
+		}
+		else if (t != FLOAT_INF) {
+			pixel.direct += throughput * emitted;
+		}
+	}
+
+	void PhotonMappingRenderer::gatherTask(const Tile& tile) {
+		for (int i = tile.y0; i < tile.y1; i++) {
+			for (int j = tile.x0; j < tile.x1; j++) {
+				auto& pixel = sppmPixels[i * width + j];
+				if (!pixel.vp.valid) continue;
+				float m = 0;
+				Vec3 flux{ 0 };
+				globalMap.tree.forEachInRadius(pixel.vp.position, pixel.radius2, [&](const Photon& p) {
+					if (glm::dot(p.direction, pixel.vp.normal) < 0) {
+						m += 1;
+						flux += p.power;
+					}
+				});
+				if (m == 0) continue;
+				// N' = N + alpha*M, R'^2 = R^2 * N'/(N+M), tau' = (tau + flux) * R'^2/R^2
+				float ratio = (pixel.n + sppmAlpha * m) / (pixel.n + m);
+				pixel.n += sppmAlpha * m;
+				pixel.radius2 *= ratio;
+				pixel.tau = (pixel.tau + pixel.vp.weight * flux) * ratio;
+			}
+		}
+	}
+
+	void PhotonMappingRenderer::resolveTask(RGBA* pixels, unsigned int pass, const Tile& tile) {
+		for (int i = tile.y0; i < tile.y1; i++) {
+			for (int j = tile.x0; j < tile.x1; j++) {
+				auto& pixel = sppmPixels[i * width + j];
+				// tau / (PI r^2) 为漫反射颜色乘辐照度, 再除以PI得到出射辐亮度
+				Vec3 color = pixel.direct / float(pass) + pixel.tau / (PI * PI * pixel.radius2 * float(pass));
+				pixels[i * width + j] = { gamma(color), 1 };
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#include "ProjectionMap.hpp"
+
+namespace PhotonMapping
+{
+    ProjectionMap::ProjectionMap()
+        : marked            (zRes * phiRes, 0)
+        , markedCells       ()
+    {}
+
+    Vec3 ProjectionMap::cellDirection(unsigned int cell, float u1, float u2) {
+        constexpr float C_PI = 3.14159265358979323846264338327950288f;
+        float z = (float(cell / phiRes) + u1) / float(zRes);
+        float phi = 2 * C_PI * (float(cell % phiRes) + u2) / float(phiRes);
+        float r = sqrt(glm::max(0.f, 1 - z * z));
+        return { r * cos(phi), r * sin(phi), z };
+    }
+
+    void ProjectionMap::mark(unsigned int cell) {
+        marked[cell] = 1;
+    }
+
+    void ProjectionMap::finish() {
+        auto dilated = marked;
+        for (unsigned int i = 0; i < zRes; i++) {
+            for (unsigned int j = 0; j < phiRes; j++) {
+                if (!marked[i * phiRes + j]) continue;
+                for (int di = -1; di <= 1; di++) {
+                    int ni = int(i) + di;
+                    if (ni < 0 || ni >= int(zRes)) continue;
+                    for (int dj = -1; dj <= 1; dj++) {
+                        // φ方向首尾相接
+                        unsigned int nj = (j + phiRes + dj) % phiRes;
+                        dilated[ni * phiRes + nj] = 1;
+                    }
+                }
+            }
+        }
+        marked = std::move(dilated);
+        markedCells.clear();
+        for (unsigned int i = 0; i < marked.size(); i++) {
+            if (marked[i]) markedCells.push_back(i);
+        }
+    }
+
+    bool ProjectionMap::empty() const {
+        return markedCells.empty();
+    }
+
+    float ProjectionMap::fraction() const {
+        return float(markedCells.size()) / float(marked.size());
+    }
+
+    Vec3 ProjectionMap::sample(float u0, float u1, float u2) const {
+        size_t index = glm::min(size_t(u0 * float(markedCells.size())), markedCells.size() - 1);
+        return cellDirection(markedCells[index], u1, u2);
+    }
+}
@@ -1,5 +1,4 @@
 #include "shaders/Conductor.hpp"
-#include "samplers/SamplerInstance.hpp"
 
 namespace PhotonMapping
 {
@@ -9,7 +8,7 @@ namespace PhotonMapping
 		albedo = material.getProperty<Property::Wrapper::RGBType>("reflect")->value;
 	}
 
-	Scattered Conductor::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const {
+	Scattered Conductor::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const {
 		auto in = glm::normalize(ray.direction);
 		auto n = glm::normalize(normal);
 
@@ -1,5 +1,4 @@
 #include "shaders/Dielectric.hpp"
-#include "samplers/SamplerInstance.hpp"
 
 namespace PhotonMapping
 {
@@ -10,7 +9,7 @@ namespace PhotonMapping
 		absorbed = material.getProperty<Property::Wrapper::RGBType>("absorbed")->value;
 	}
 
-	Scattered Dielectric::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const {
+	Scattered Dielectric::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const {
 
 		/*cout << "dielectric shade" << endl;*/
 
@@ -20,7 +19,7 @@ namespace PhotonMapping
 		auto in = glm::normalize(ray.direction);
 		auto n = glm::normalize(normal);
 
-		Vec3 dir = scatterHelper(in, n, n1, n2);
+		Vec3 dir = scatterHelper(in, n, n1, n2, sample.x);
 
 		return {
 			Ray{hitPoint, dir},
@@ -2,6 +2,8 @@
 
 #include "VertexTransformer.hpp"
 #include "intersections/intersections.hpp"
+
+#include "utilities/TileScheduler.hpp"
 namespace RayCast
 {
     void RayCastRenderer::release(const RenderResult& r) {
@@ -24,15 +26,18 @@ namespace RayCast
             shaderPrograms.push_back(shaderCreator.create(mtl, scene.textures));
         }
 
-        for (int i=0; i<height; i++) {
-            for (int j=0; j < width; j++) {
-                auto ray = camera.shoot(float(j)/float(width), float(i)/float(height));
-                auto color = trace(ray);
-                color = clamp(color);
-                color = gamma(color);
-                pixels[(height-i-1)*width+j] = {color, 1};
+        TileScheduler scheduler{width, height, scene.renderOption.tileSize, scene.renderOption.threads};
+        scheduler.run([&](const Tile& tile, unsigned int) {
+            for (int i=tile.y0; i<tile.y1; i++) {
+                for (int j=tile.x0; j < tile.x1; j++) {
+                    auto ray = camera.shoot(float(j)/float(width), float(i)/float(height));
+                    auto color = trace(ray);
+                    color = clamp(color);
+                    color = gamma(color);
+                    pixels[(height-i-1)*width+j] = {color, 1};
+                }
             }
-        }
+        });
 
         return {pixels, width, height};
     }
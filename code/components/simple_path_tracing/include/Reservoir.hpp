@@ -0,0 +1,58 @@
+#pragma once
+#ifndef __RESERVOIR_HPP__
+#define __RESERVOIR_HPP__
+
+#include "geometry/vec.hpp"
+
+namespace SimplePathTracer
+{
+    using namespace NRenderer;
+
+    // 加权蓄水池采样(weighted reservoir sampling), 用于resampled importance sampling(ReSTIR, Bitterli 2020)
+    // 流式地从候选中按权重选出一个, 只保存选中的样本和权重和, 合并两个蓄水池是O(1)的
+    // 样本为面光源light上的一点point
+    struct Reservoir
+    {
+        int light = -1;
+        Vec3 point{ 0 };
+        // 选中样本在所属像素的目标函数值
+        float target = 0;
+        float weightSum = 0;
+        // 参与的候选数, 合并时用于加权; 用float便于限制时间复用的历史长度
+        float M = 0;
+        // 选中样本的贡献权重, 估计为 f(y) * W
+        float W = 0;
+
+        // 加入一个候选, weight = target / 源分布的概率密度, u为[0, 1)上的随机数
+        bool add(int candidate, const Vec3& p, float candidateTarget, float weight, float u) {
+            M += 1;
+            return update(candidate, p, candidateTarget, weight, u);
+        }
+
+        // 合并另一个蓄水池, targetHere为other选中的样本在当前像素的目标函数值
+        // misWeight为该样本的MIS权重, 所有参与合并的蓄水池对同一个样本的权重之和为1时结果无偏
+        bool merge(const Reservoir& other, float targetHere, float misWeight, float u) {
+            M += other.M;
+            float weight = other.light >= 0 ? targetHere * other.W * misWeight : 0.f;
+            return update(other.light, other.point, targetHere, weight, u);
+        }
+
+        // 只有一个像素的候选时normalization为M, 合并时已经用MIS权重归一化, 为1
+        void computeWeight(float normalization) {
+            W = target > 0 && normalization > 0 ? weightSum / (normalization * target) : 0.f;
+        }
+
+    private:
+        bool update(int candidate, const Vec3& p, float candidateTarget, float weight, float u) {
+            if (!(weight > 0)) return false;
+            weightSum += weight;
+            if (u * weightSum >= weight) return false;
+            light = candidate;
+            point = p;
+            target = candidateTarget;
+            return true;
+        }
+    };
+}
+
+#endif
@@ -6,10 +6,17 @@
 #include "Ray.hpp"
 #include "Camera.hpp"
 #include "intersections/HitRecord.hpp"
+#include "Reservoir.hpp"
 
 #include "shaders/ShaderCreator.hpp"
+#include "samplers/PixelSamplerCreator.hpp"
+
+#include "utilities/TileScheduler.hpp"
+#include "utilities/Denoiser.hpp"
+#include "utilities/LightTree.hpp"
 
 #include <tuple>
+#include <vector>
 namespace SimplePathTracer
 {
     using namespace NRenderer;
@@ -26,35 +33,175 @@ namespace SimplePathTracer
         unsigned int height;
         unsigned int depth;
         unsigned int samples;
+        // 从该深度开始做russian roulette
+        unsigned int russianRouletteDepth;
+
+        // 下一事件估计: 在交点按功率选择面光源, 在光源上取点发射阴影光线, 与BSDF采样用power heuristic做MIS
+        bool lightSampling;
+        // 按功率的累积分布
+        vector<float> lightCdf;
+        // 光源层次结构: 按着色点的位置和法线选择光源, 同时加速光线与光源求交, 关闭时使用lightCdf并逐个求交
+        bool lightBVH;
+        LightTree lightTree;
+
+        // 自适应采样: 先每像素采样minSamples次, 之后把剩余的 samples*像素数 的预算分批按相对误差分给各像素
+        bool adaptiveSampling;
+        unsigned int minSamples;
+        unsigned int maxSamples;
+        // Welford 累计每个像素的颜色均值和亮度方差
+        struct PixelEstimate
+        {
+            unsigned int n = 0;
+            RGB mean{0};
+            float luminanceMean = 0;
+            float m2 = 0;
+            void add(const RGB& color);
+            // 亮度均值的标准误差 / 均值
+            float relativeError() const;
+        };
+        vector<PixelEstimate> estimates;
+
+        // 渐进式渲染: 每一轮每像素采样passSamples次累加到浮点缓冲区, 每轮结束后更新Screen, 可以随时停止
+        bool progressive;
+        unsigned int passSamples;
+        vector<RGB> accumulation;
 
         using SCam = SimplePathTracer::Camera;
         SCam camera;
 
         vector<SharedShader> shaderPrograms;
+
+        // 摄像机、BSDF和光源采样的样本都由pixelSampler按 (像素, 采样下标, 维度) 给出
+        RenderSettings::SamplerType samplerType;
+        SharedPixelSampler pixelSampler;
+
+        TileScheduler scheduler;
+
+        // 降噪: 每次采样记录首个交点的albedo、法线和深度, 所有采样结束后滤波
+        bool denoise;
+        unsigned int denoiseIterations;
+        vector<DenoisePixel> denoisePixels;
+
+        // 附加输出通道(AOV_CHANNELS的子集), 渲染循环按掩码实例化, 关闭时没有额外开销
+        unsigned int aovChannels;
+        vector<AovPixel> aovPixels;
+        FrameBuffer aovs;
+
+        // ReSTIR: 每次采样逐帧进行, 首个交点的直接光照由每像素的蓄水池给出
+        // 先从restirCandidates个光源样本中重采样, 再与半径restirRadius像素内的restirNeighbors个邻居合并(空间复用)
+        // 渐进式渲染时与上一帧的蓄水池合并(时间复用); 其余的弹射仍然按lightSampling计算
+        bool restir;
+        unsigned int restirCandidates;
+        unsigned int restirNeighbors;
+        float restirRadius;
+        bool restirTemporal;
+        struct RestirPixel
+        {
+            // 首个交点, material为-1时没有打到表面
+            Vec3 point{0};
+            Vec3 normal{0};
+            float depth = 0;
+            int material = -1;
+            // 路径中除首个交点直接光照以外的部分
+            RGB color{0};
+            SurfaceFeature feature{};
+            Reservoir reservoir;
+        };
+        struct RestirInput
+        {
+            const Reservoir* reservoir;
+            const RestirPixel* surface;
+        };
+        vector<RestirPixel> restirPixels;
+        // 上一帧空间复用后的蓄水池, 作为时间复用的输入
+        vector<Reservoir> restirHistory;
+        vector<Reservoir> restirSpatial;
     public:
         SimplePathTracerRenderer(SharedScene spScene)
             : spScene               (spScene)
             , scene                 (*spScene)
             , camera                (spScene->camera)
+            , scheduler             (spScene->renderOption.width, spScene->renderOption.height,
+                                    spScene->renderOption.tileSize, spScene->renderOption.threads)
         {
             width = scene.renderOption.width;
             height = scene.renderOption.height;
             depth = scene.renderOption.depth;
             samples = scene.renderOption.samplesPerPixel;
+            lightSampling = scene.renderOption.lightSampling;
+            lightBVH = scene.renderOption.lightBVH;
+            russianRouletteDepth = scene.renderOption.russianRouletteDepth;
+            adaptiveSampling = scene.renderOption.adaptiveSampling;
+            // 估计方差至少需要两个样本
+            minSamples = glm::max(2u, glm::min(scene.renderOption.minSamples, samples));
+            maxSamples = glm::max(samples, scene.renderOption.maxSamples);
+            progressive = scene.renderOption.progressive;
+            passSamples = glm::max(1u, scene.renderOption.passSamples);
+            samplerType = scene.renderOption.sampler;
+            denoise = scene.renderOption.denoise;
+            denoiseIterations = scene.renderOption.denoiseIterations;
+            aovChannels = scene.renderOption.aovChannels & AOV_CHANNELS;
+            // 最大深度为1时首个交点不计算直接光照
+            restir = scene.renderOption.restir && depth > 1;
+            restirCandidates = glm::max(1u, scene.renderOption.restirCandidates);
+            restirNeighbors = scene.renderOption.restirNeighbors;
+            restirRadius = scene.renderOption.restirRadius;
+            restirTemporal = false;
         }
         ~SimplePathTracerRenderer() = default;
 
         using RenderResult = tuple<RGBA*, unsigned int, unsigned int>;
         RenderResult render();
         void release(const RenderResult& r);
+        // render之后有效, 只包含请求的通道
+        const FrameBuffer& getAovs() const { return aovs; }
 
     private:
-        void renderTask(RGBA* pixels, int width, int height, int off, int step);
+        // Channels为要输出的AOV通道
+        template <unsigned int Channels>
+        void renderTask(RGBA* pixels, const Tile& tile);
+        // index为该像素的第几次采样
+        template <unsigned int Channels>
+        RGB samplePixel(int i, int j, unsigned int index);
+        void renderAdaptive(RGBA* pixels);
+        template <unsigned int Channels>
+        void adaptiveTask(const vector<unsigned int>& counts, const Tile& tile);
+        void renderProgressive(RGBA* pixels);
+        template <unsigned int Channels>
+        void progressiveTask(RGBA* pixels, unsigned int total, unsigned int count, const Tile& tile);
+        void denoiseImage(RGBA* pixels, double renderTime);
+
+        // ReSTIR, 每帧每像素一次采样, index为采样下标
+        void renderRestir(RGBA* pixels);
+        void restirFrame(RGBA* pixels, unsigned int index);
+        // 生成候选并做时间复用
+        template <unsigned int Channels>
+        void restirSampleTask(unsigned int index, const Tile& tile);
+        // 空间复用, 计算直接光照并累加
+        template <unsigned int Channels>
+        void restirShadeTask(RGBA* pixels, unsigned int index, const Tile& tile);
+        // 首个交点到光源上一点的未遮挡贡献, 目标函数取它的亮度
+        RGB restirContribution(const RestirPixel& pixel, int light, const Vec3& point) const;
+        float restirTarget(const RestirPixel& pixel, int light, const Vec3& point) const;
+        bool restirSimilar(const RestirPixel& a, const RestirPixel& b) const;
+        // 合并多个交点的蓄水池, 按当前像素pixel的目标函数重采样, MIS权重考虑各输入交点的可见性
+        Reservoir restirCombine(const RestirPixel& pixel, const vector<RestirInput>& inputs, Pcg32& rng);
+        bool visible(const Vec3& from, const Vec3& point);
 
         RGB gamma(const RGB& rgb);
-        RGB trace(const Ray& ray, int currDepth);
+        Ray primaryRay(int i, int j, SampleStream& stream);
+        // feature不为空时写入首个交点的特征
+        // primary不为空时写入首个交点, 并且不计算首个交点的直接光照, 由ReSTIR计算
+        RGB trace(const Ray& ray, SampleStream& stream, SurfaceFeature* feature = nullptr, RestirPixel* primary = nullptr);
+        string samplerName() const;
         HitRecord closestHitObject(const Ray& r);
-        tuple<float, Vec3> closestHitLight(const Ray& r);
+        // 返回 { t, radiance, 光源下标 }
+        tuple<float, Vec3, int> closestHitLight(const Ray& r);
+
+        void buildLightCdf();
+        // normal为r.origin处的法线, 光源层次结构按它计算选择概率
+        float lightPdf(const Ray& r, float t, int light, const Vec3& normal) const;
+        RGB sampleLight(const HitRecordBase& hit, const Shader& shader, SampleStream& stream);
     };
 }
 
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef __HALTON_SAMPLER_HPP__
+#define __HALTON_SAMPLER_HPP__
+
+#include "PixelSampler.hpp"
+
+#include <vector>
+#include <random>
+#include <cmath>
+
+namespace SimplePathTracer
+{
+    // 置换Halton序列, 第dim维以第dim个素数为底做根式反演, 每一维的数字经过固定的随机置换
+    // 所有像素共用同一个序列, 每个像素每一维加一个随机的平移(Cranley-Patterson)
+    // 超出素数表的维度退化为独立随机数
+    class HaltonSampler : public PixelSampler
+    {
+    public:
+        constexpr static uint32_t dimensions = 64;
+    private:
+        vector<uint32_t> primes;
+        vector<vector<uint16_t>> permutations;
+        // 固定反演 digits 位, 使 base^digits >= 2^32, 否则高位的0被置换后成为无穷级数
+        // tails[dim][i]: 第i位及以后都是0时, 这些位置换后的和, 下标用完后直接查表
+        vector<vector<double>> tails;
+
+        double radicalInverse(uint32_t dim, uint64_t index) const {
+            uint32_t base = primes[dim];
+            auto& perm = permutations[dim];
+            double invBase = 1.0 / base;
+            double invBaseN = 1.0;
+            double v = 0;
+            uint32_t i = 0;
+            for (; index != 0; i++) {
+                uint64_t next = index / base;
+                invBaseN *= invBase;
+                v += perm[index - next * base] * invBaseN;
+                index = next;
+            }
+            return v + tails[dim][i];
+        }
+    public:
+        HaltonSampler() {
+            for (uint32_t n = 2; primes.size() < dimensions; n++) {
+                bool prime = true;
+                for (auto p : primes) {
+                    if (p * p > n) break;
+                    if (n % p == 0) {
+                        prime = false;
+                        break;
+                    }
+                }
+                if (prime) primes.push_back(n);
+            }
+            mt19937 e{ 0 };
+            permutations.resize(dimensions);
+            tails.resize(dimensions);
+            for (uint32_t d = 0; d < dimensions; d++) {
+                permutations[d].resize(primes[d]);
+                for (uint32_t i = 0; i < primes[d]; i++) permutations[d][i] = uint16_t(i);
+                shuffle(permutations[d].begin(), permutations[d].end(), e);
+                uint32_t digits = 0;
+                for (double range = 1; range < 4294967296.0; range *= primes[d]) digits++;
+                tails[d].assign(digits + 1, 0.0);
+                for (int i = int(digits) - 1; i >= 0; i--) {
+                    tails[d][i] = tails[d][i + 1] + permutations[d][0] * pow(1.0 / primes[d], i + 1);
+                }
+            }
+        }
+
+        float get1d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            if (dim >= dimensions) return toUnitFloat(uint32_t(hashValues(pixel, index, dim)));
+            double shift = double(uint32_t(hashValues(pixel, dim))) * 0x1p-32;
+            double v = radicalInverse(dim, index) + shift;
+            if (v >= 1) v -= 1;
+            return min(float(v), ONE_MINUS_EPSILON);
+        }
+
+        Vec2 get2d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            return { get1d(pixel, index, dim), get1d(pixel, index, dim + 1) };
+        }
+    };
+}
+
+#endif
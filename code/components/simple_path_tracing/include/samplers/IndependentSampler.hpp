@@ -0,0 +1,24 @@
+#pragma once
+#ifndef __INDEPENDENT_SAMPLER_HPP__
+#define __INDEPENDENT_SAMPLER_HPP__
+
+#include "PixelSampler.hpp"
+
+namespace SimplePathTracer
+{
+    // 不分层, 每一维都取独立的随机数, 作为对比的基准
+    // 直接对 (像素, 第几次采样, 第几维) 做哈希, 与线程和调用顺序无关
+    class IndependentSampler : public PixelSampler
+    {
+    public:
+        float get1d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            return toUnitFloat(uint32_t(hashValues(pixel, index, dim)));
+        }
+
+        Vec2 get2d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            return { get1d(pixel, index, dim), get1d(pixel, index, dim + 1) };
+        }
+    };
+}
+
+#endif
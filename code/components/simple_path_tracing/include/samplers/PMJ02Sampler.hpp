@@ -0,0 +1,37 @@
+#pragma once
+#ifndef __PMJ02_SAMPLER_HPP__
+#define __PMJ02_SAMPLER_HPP__
+
+#include "PixelSampler.hpp"
+
+#include <vector>
+
+namespace SimplePathTracer
+{
+    // 渐进多重抖动(0,2)序列(Christensen 2018)
+    // 任意2的幂个前缀样本在所有 2^a * 2^b (a+b=m) 的初等区间上都恰好各有一个样本
+    // 预先生成setNums组, 每组tableSize个点; 每个像素每两维按哈希选一组, 再做Owen置换, 置换后仍保持分层
+    // 超过tableSize次采样时换下一组, 每tableSize个样本内仍然分层
+    class PMJ02Sampler : public PixelSampler
+    {
+    public:
+        constexpr static uint32_t setNums = 32;
+        constexpr static uint32_t tableSize = 1024;
+    private:
+        // 32位定点数
+        struct Point
+        {
+            uint32_t x, y;
+        };
+        using Table = vector<Point>;
+        static const vector<Table>& tables();
+        static Table generate(uint32_t seed);
+    public:
+        PMJ02Sampler();
+
+        float get1d(uint32_t pixel, uint32_t index, uint32_t dim) const override;
+        Vec2 get2d(uint32_t pixel, uint32_t index, uint32_t dim) const override;
+    };
+}
+
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef __PIXEL_SAMPLER_HPP__
+#define __PIXEL_SAMPLER_HPP__
+
+#include "geometry/vec.hpp"
+#include "common/macros.hpp"
+#include "utilities/Random.hpp"
+
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <bit>
+
+namespace SimplePathTracer
+{
+    using namespace std;
+    using NRenderer::Vec2;
+    using NRenderer::ONE_MINUS_EPSILON;
+    using NRenderer::mixBits;
+    using NRenderer::hashValues;
+    using NRenderer::toUnitFloat;
+
+    inline uint32_t reverseBits(uint32_t v) {
+        v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+        v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+        v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+        v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    // Owen置换(Laine-Karras哈希): 每一位只由更高的位和种子决定是否翻转
+    // 作用在 [0, 1) 的32位定点数上时保持所有初等区间的分层
+    inline uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) {
+        x = reverseBits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverseBits(x);
+    }
+
+    // [0, n) 上由seed决定的随机排列的第i个元素(Kensler 2013)
+    inline uint32_t permutationElement(uint32_t i, uint32_t n, uint32_t seed) {
+        uint32_t w = n - 1;
+        w |= w >> 1;
+        w |= w >> 2;
+        w |= w >> 4;
+        w |= w >> 8;
+        w |= w >> 16;
+        do {
+            i ^= seed;
+            i *= 0xe170893du;
+            i ^= seed >> 16;
+            i ^= (i & w) >> 4;
+            i ^= seed >> 8;
+            i *= 0x0929eb3fu;
+            i ^= seed >> 23;
+            i ^= (i & w) >> 1;
+            i *= 1 | seed >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11;
+            i *= 0x74dcb303u;
+            i ^= (i & w) >> 2;
+            i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2;
+            i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= n);
+        return (i + seed) % n;
+    }
+
+    // 只在 [2^j, 2^(j+1)) 内打乱采样下标, 2的幂长的前缀仍是原来的那些点
+    // 不同维度用不同的种子, 各维之间第k个样本不再对应; 用Owen置换打乱下标时各维之间仍有相关
+    inline uint32_t shuffleIndex(uint32_t index, uint32_t seed) {
+        if (index < 2) return index;
+        uint32_t octave = bit_floor(index);
+        return octave + permutationElement(index - octave, octave, seed);
+    }
+
+    // 按 (像素, 第几次采样, 第几维) 取样本, 与调用顺序和线程无关
+    // 同一个像素的不同采样在每一维上分层, 不同像素之间去相关
+    class PixelSampler
+    {
+    public:
+        virtual ~PixelSampler() = default;
+        // 返回[0, 1)
+        virtual float get1d(uint32_t pixel, uint32_t index, uint32_t dim) const = 0;
+        // 占用dim和dim+1两维, 两维之间也分层
+        virtual Vec2 get2d(uint32_t pixel, uint32_t index, uint32_t dim) const = 0;
+    };
+    SHARE(PixelSampler);
+
+    // 一条路径上的样本, 按维度依次取
+    // 每次弹射从固定的维度开始, 路径在某一步少取了样本时后面的维度不会错位
+    class SampleStream
+    {
+    private:
+        const PixelSampler& sampler;
+        uint32_t pixel;
+        uint32_t index;
+        uint32_t dim;
+    public:
+        // 摄像机: 像素内位置2维 + 镜头2维
+        constexpr static uint32_t cameraDimensions = 4;
+        // 每次弹射: BSDF 2维 + 选光源1维 + 光源上的点2维 + russian roulette 1维
+        constexpr static uint32_t bounceDimensions = 6;
+
+        SampleStream(const PixelSampler& sampler, uint32_t pixel, uint32_t index)
+            : sampler               (sampler)
+            , pixel                 (pixel)
+            , index                 (index)
+            , dim                   (0)
+        {}
+
+        void startBounce(uint32_t depth) {
+            dim = cameraDimensions + depth * bounceDimensions;
+        }
+
+        float next1d() {
+            return sampler.get1d(pixel, index, dim++);
+        }
+
+        Vec2 next2d() {
+            auto v = sampler.get2d(pixel, index, dim);
+            dim += 2;
+            return v;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef __PIXEL_SAMPLER_CREATOR_HPP__
+#define __PIXEL_SAMPLER_CREATOR_HPP__
+
+#include "scene/Scene.hpp"
+
+#include "IndependentSampler.hpp"
+#include "HaltonSampler.hpp"
+#include "SobolSampler.hpp"
+#include "PMJ02Sampler.hpp"
+
+namespace SimplePathTracer
+{
+    using NRenderer::RenderSettings;
+    class PixelSamplerCreator
+    {
+    public:
+        PixelSamplerCreator() = default;
+        SharedPixelSampler create(RenderSettings::SamplerType type) {
+            SharedPixelSampler sampler{nullptr};
+            switch (type)
+            {
+            case RenderSettings::SamplerType::INDEPENDENT:
+                sampler = make_shared<IndependentSampler>();
+                break;
+            case RenderSettings::SamplerType::HALTON:
+                sampler = make_shared<HaltonSampler>();
+                break;
+            case RenderSettings::SamplerType::PMJ02:
+                sampler = make_shared<PMJ02Sampler>();
+                break;
+            default:
+                sampler = make_shared<SobolSampler>();
+                break;
+            }
+            return sampler;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef __SOBOL_SAMPLER_HPP__
+#define __SOBOL_SAMPLER_HPP__
+
+#include "PixelSampler.hpp"
+
+namespace SimplePathTracer
+{
+    // Owen置换的Sobol序列
+    // 只用Sobol的前两维, 它们构成(0,2)序列; 更高的维度按两维一组拼接(padding), 每组用不同的种子打乱采样下标
+    class SobolSampler : public PixelSampler
+    {
+    private:
+        // 第二维, 生成矩阵由 v_k = v_{k-1} ^ (v_{k-1} >> 1) 给出
+        static uint32_t sobol1(uint32_t index) {
+            uint32_t r = 0;
+            for (uint32_t v = 0x80000000u; index != 0; index >>= 1, v ^= v >> 1) {
+                if (index & 1) r ^= v;
+            }
+            return r;
+        }
+    public:
+        float get1d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            uint64_t seed = hashValues(pixel, dim, 0);
+            uint32_t i = shuffleIndex(index, uint32_t(seed));
+            return toUnitFloat(nestedUniformScramble(reverseBits(i), uint32_t(seed >> 32)));
+        }
+
+        Vec2 get2d(uint32_t pixel, uint32_t index, uint32_t dim) const override {
+            uint64_t seed = hashValues(pixel, dim, 1);
+            uint32_t i = shuffleIndex(index, uint32_t(seed));
+            uint64_t scramble = mixBits(seed);
+            return {
+                toUnitFloat(nestedUniformScramble(reverseBits(i), uint32_t(scramble))),
+                toUnitFloat(nestedUniformScramble(sobol1(i), uint32_t(scramble >> 32)))
+            };
+        }
+    };
+}
+
+#endif
@@ -12,7 +12,9 @@ namespace SimplePathTracer
         Vec3 albedo;
     public:
         Lambertian(Material& material, vector<Texture>& textures);
-        Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const;
+        Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const;
+        Vec3 evaluate(const Vec3& in, const Vec3& normal) const;
+        float pdf(const Vec3& in, const Vec3& normal) const;
     };
 }
 
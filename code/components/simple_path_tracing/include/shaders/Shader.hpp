@@ -7,6 +7,7 @@
 #include "scene/Scene.hpp"
 
 #include "Scattered.hpp"
+#include "samplers/PixelSampler.hpp"
 
 namespace SimplePathTracer
 {
@@ -25,7 +26,11 @@ namespace SimplePathTracer
             : material              (material)
             , textureBuffer         (textures)
         {}
-        virtual Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const = 0;
+        // sample为[0, 1)^2上的样本, 由调用者的采样器提供
+        virtual Scattered shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const = 0;
+        // in为从交点指向光源的方向, 返回该方向的BRDF值和shade采样到该方向的概率密度, 用于光源采样和MIS
+        virtual Vec3 evaluate(const Vec3& in, const Vec3& normal) const = 0;
+        virtual float pdf(const Vec3& in, const Vec3& normal) const = 0;
     };
     SHARE(Shader);
 }
@@ -17,6 +17,7 @@ namespace SimplePathTracer
             auto renderResult = renderer.render();
             auto [ pixels, width, height ]  = renderResult;
             getServer().screen.set(pixels, width, height);
+            getServer().screen.setChannels(renderer.getAovs());
             renderer.release(renderResult);
         }
     };
@@ -0,0 +1,200 @@
+#include "server/Server.hpp"
+
+#include "SimplePathTracer.hpp"
+
+#include "utilities/Random.hpp"
+
+#include <algorithm>
+
+namespace SimplePathTracer
+{
+    // 时间复用的历史最多相当于当前帧候选数的多少倍, 限制旧样本的权重
+    constexpr float restirHistoryLimit = 20.f;
+
+    RGB SimplePathTracerRenderer::restirContribution(const RestirPixel& pixel, int light, const Vec3& point) const {
+        if (pixel.material < 0 || light < 0) return Vec3{0};
+        auto& a = scene.areaLightBuffer[light];
+        Vec3 toLight = point - pixel.point;
+        float dist2 = glm::dot(toLight, toLight);
+        if (dist2 <= 0) return Vec3{0};
+        Vec3 direction = toLight / sqrt(dist2);
+        float cosSurface = glm::dot(pixel.normal, direction);
+        Vec3 lightNormal = glm::cross(a.u, a.v);
+        // 光源两面都发光, 与closestHitLight一致
+        float cosLight = fabs(glm::dot(lightNormal, direction)) / glm::length(lightNormal);
+        if (cosSurface <= 0 || cosLight <= 0) return Vec3{0};
+        return shaderPrograms[pixel.material]->evaluate(direction, pixel.normal) * a.radiance * cosSurface * cosLight / dist2;
+    }
+
+    float SimplePathTracerRenderer::restirTarget(const RestirPixel& pixel, int light, const Vec3& point) const {
+        return glm::dot(restirContribution(pixel, light, point), Vec3{0.2126f, 0.7152f, 0.0722f});
+    }
+
+    // 法线夹角小于约25度、深度相差小于10%的两个交点才互相复用
+    bool SimplePathTracerRenderer::restirSimilar(const RestirPixel& a, const RestirPixel& b) const {
+        if (a.material < 0 || b.material < 0) return false;
+        return glm::dot(a.normal, b.normal) > 0.9f && fabs(a.depth - b.depth) < 0.1f * b.depth;
+    }
+
+    // 广义balance heuristic: 样本y_i的MIS权重为 M_i p_i(y_i) / sum_j M_j p_j(y_i), p_j为第j个输入所在交点的目标函数乘可见性
+    // 被遮挡的蓄水池W为0但保留M, p_j不含可见性时分母偏大、权重之和小于1, 阴影边缘会变暗
+    // 输入自身的样本在其交点可见(否则W为0), 其余交点各发射一条阴影光线
+    Reservoir SimplePathTracerRenderer::restirCombine(const RestirPixel& pixel, const vector<RestirInput>& inputs, Pcg32& rng) {
+        Reservoir s;
+        for (auto& input : inputs) {
+            auto& r = *input.reservoir;
+            float targetHere = restirTarget(pixel, r.light, r.point);
+            float mis = 0;
+            if (r.light >= 0 && r.W > 0 && targetHere > 0) {
+                float sum = 0;
+                for (auto& other : inputs) {
+                    float target = restirTarget(*other.surface, r.light, r.point);
+                    if (target > 0 && &other != &input && !visible(other.surface->point, r.point)) target = 0;
+                    sum += other.reservoir->M * target;
+                }
+                mis = sum > 0 ? r.M * restirTarget(*input.surface, r.light, r.point) / sum : 0.f;
+            }
+            s.merge(r, targetHere, mis, rng.nextFloat());
+        }
+        s.computeWeight(1);
+        return s;
+    }
+
+    bool SimplePathTracerRenderer::visible(const Vec3& from, const Vec3& point) {
+        Vec3 toLight = point - from;
+        float dist = glm::length(toLight);
+        if (dist <= 0) return false;
+        auto occluder = closestHitObject(Ray{from, toLight / dist});
+        return !occluder || occluder->t >= dist * (1 - 1e-4f);
+    }
+
+    template <unsigned int Channels>
+    void SimplePathTracerRenderer::restirSampleTask(unsigned int index, const Tile& tile) {
+        bool features = denoise || (Channels & FEATURE_CHANNELS) != 0;
+        for(int i=tile.y0; i<tile.y1; i++) {
+            for (int j=tile.x0; j<tile.x1; j++) {
+                auto p = i*width+j;
+                AovTimer<Channels> timer;
+                auto& pixel = restirPixels[p];
+                RestirPixel previous = pixel;
+                pixel.material = -1;
+                pixel.feature = {};
+                SampleStream stream{*pixelSampler, uint32_t(p), index};
+                auto ray = primaryRay(i, j, stream);
+                pixel.color = trace(ray, stream, features ? &pixel.feature : nullptr, &pixel);
+
+                // resampled importance sampling: 按lightTree或lightCdf选光源, 在光源上均匀取点, 按未遮挡的贡献重采样
+                Pcg32 rng{hashValues(p, index), 3};
+                Reservoir r;
+                if (pixel.material >= 0) {
+                    for (unsigned int m=0; m < restirCandidates; m++) {
+                        float u = rng.nextFloat();
+                        auto uv = rng.next2d();
+                        int light = -1;
+                        float select = 0;
+                        if (lightBVH) {
+                            tie(light, select) = lightTree.sample(pixel.point, pixel.normal, u);
+                        }
+                        else if (!lightCdf.empty()) {
+                            light = int(upper_bound(lightCdf.begin(), lightCdf.end(), u) - lightCdf.begin());
+                            light = min(light, int(lightCdf.size()) - 1);
+                            select = lightCdf[light] - (light > 0 ? lightCdf[light - 1] : 0.f);
+                        }
+                        if (light < 0 || select <= 0) {
+                            r.M += 1;
+                            continue;
+                        }
+                        auto& a = scene.areaLightBuffer[light];
+                        Vec3 point = a.position + uv.x*a.u + uv.y*a.v;
+                        float target = restirTarget(pixel, light, point);
+                        // 面积测度下的概率密度 select / area
+                        float area = glm::length(glm::cross(a.u, a.v));
+                        r.add(light, point, target, target * area / select, rng.nextFloat());
+                    }
+                    r.computeWeight(r.M);
+                    // 被遮挡的样本不参与复用
+                    if (r.light >= 0 && !visible(pixel.point, r.point)) r.W = 0;
+                }
+
+                // 时间复用: 相机不动, 与同一像素上一帧的蓄水池合并
+                if (restirTemporal && restirSimilar(previous, pixel)) {
+                    Reservoir history = restirHistory[p];
+                    history.M = min(history.M, restirHistoryLimit * r.M);
+                    r = restirCombine(pixel, { { &r, &pixel }, { &history, &previous } }, rng);
+                    // 历史样本可能在当前交点被遮挡, 同样不参与空间复用
+                    if (r.W > 0 && !visible(pixel.point, r.point)) r.W = 0;
+                }
+                pixel.reservoir = r;
+                if constexpr (Channels != 0) timer.stop(aovPixels[p]);
+            }
+        }
+    }
+
+    template <unsigned int Channels>
+    void SimplePathTracerRenderer::restirShadeTask(RGBA* pixels, unsigned int index, const Tile& tile) {
+        vector<RestirInput> inputs;
+        for(int i=tile.y0; i<tile.y1; i++) {
+            for (int j=tile.x0; j<tile.x1; j++) {
+                auto p = i*width+j;
+                AovTimer<Channels> timer;
+                auto& pixel = restirPixels[p];
+                RGB color = pixel.color;
+                if (pixel.material >= 0) {
+                    // 空间复用: 与附近相似交点的蓄水池合并, 样本按当前像素的目标函数重新加权
+                    Pcg32 rng{hashValues(p, index), 4};
+                    inputs.assign(1, { &pixel.reservoir, &pixel });
+                    for (unsigned int k=0; k < restirNeighbors; k++) {
+                        auto d = rng.next2d();
+                        float radius = restirRadius * sqrt(d.x);
+                        float phi = 2 * PI * d.y;
+                        int ni = i + int(round(radius * sin(phi)));
+                        int nj = j + int(round(radius * cos(phi)));
+                        if (ni < 0 || ni >= int(height) || nj < 0 || nj >= int(width) || (ni == i && nj == j)) continue;
+                        int q = ni*int(width) + nj;
+                        auto& neighbor = restirPixels[q];
+                        if (!restirSimilar(neighbor, pixel)) continue;
+                        inputs.push_back({ &neighbor.reservoir, &neighbor });
+                    }
+                    auto s = restirCombine(pixel, inputs, rng);
+                    // 被遮挡的样本不参与下一帧的时间复用
+                    if (s.W > 0 && visible(pixel.point, s.point)) {
+                        color += restirContribution(pixel, s.light, s.point) * s.W;
+                    }
+                    else {
+                        s.W = 0;
+                    }
+                    restirSpatial[p] = s;
+                }
+                else {
+                    restirSpatial[p] = {};
+                }
+                auto& sum = accumulation[p];
+                sum += color;
+                if (denoise) denoisePixels[p].add(color, pixel.feature);
+                if constexpr (Channels != 0) {
+                    aovPixels[p].add<Channels>(pixel.feature);
+                    timer.stop(aovPixels[p]);
+                }
+                pixels[(height-i-1)*width+j] = {gamma(sum / float(index + 1)), 1};
+            }
+        }
+    }
+
+    // 两个阶段之间需要所有像素的蓄水池, 分两次调度
+    void SimplePathTracerRenderer::restirFrame(RGBA* pixels, unsigned int index) {
+        dispatchAovs(aovChannels, [this, pixels, index]<unsigned int Channels>() {
+            scheduler.run([this, index](const Tile& tile, unsigned int) { restirSampleTask<Channels>(index, tile); });
+            scheduler.run([this, pixels, index](const Tile& tile, unsigned int) { restirShadeTask<Channels>(pixels, index, tile); });
+        });
+        swap(restirHistory, restirSpatial);
+    }
+
+    void SimplePathTracerRenderer::renderRestir(RGBA* pixels) {
+        accumulation.assign(size_t(width)*height, RGB{0});
+        for (unsigned int k=0; k < samples; k++) {
+            restirFrame(pixels, k);
+        }
+        accumulation.clear();
+        accumulation.shrink_to_fit();
+    }
+}
@@ -7,25 +7,57 @@
 
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 namespace SimplePathTracer
 {
+    // power heuristic, beta = 2
+    inline float powerHeuristic(float pdf, float otherPdf) {
+        float a = pdf * pdf;
+        float b = otherPdf * otherPdf;
+        return a + b > 0 ? a / (a + b) : 0.f;
+    }
+
     RGB SimplePathTracerRenderer::gamma(const RGB& rgb) {
         return glm::sqrt(rgb);
     }
 
-    void SimplePathTracerRenderer::renderTask(RGBA* pixels, int width, int height, int off, int step) {
-        for(int i=off; i<height; i+=step) {
-            for (int j=0; j<width; j++) {
+    Ray SimplePathTracerRenderer::primaryRay(int i, int j, SampleStream& stream) {
+        auto r = stream.next2d();
+        float rx = r.x;
+        float ry = r.y;
+        float x = (float(j)+rx)/float(width);
+        float y = (float(i)+ry)/float(height);
+        return camera.shoot(x, y, stream.next2d());
+    }
+
+    template <unsigned int Channels>
+    RGB SimplePathTracerRenderer::samplePixel(int i, int j, unsigned int index) {
+        SampleStream stream{*pixelSampler, uint32_t(i*width+j), index};
+        auto ray = primaryRay(i, j, stream);
+        if (!denoise && (Channels & FEATURE_CHANNELS) == 0) {
+            if constexpr (Channels != 0) aovPixels[i*width+j].add<Channels>(SurfaceFeature{});
+            return trace(ray, stream);
+        }
+        // 每个像素只在一个块里渲染, 不需要加锁
+        SurfaceFeature feature{};
+        auto color = trace(ray, stream, &feature);
+        if (denoise) denoisePixels[i*width+j].add(color, feature);
+        if constexpr (Channels != 0) aovPixels[i*width+j].add<Channels>(feature);
+        return color;
+    }
+
+    template <unsigned int Channels>
+    void SimplePathTracerRenderer::renderTask(RGBA* pixels, const Tile& tile) {
+        for(int i=tile.y0; i<tile.y1; i++) {
+            for (int j=tile.x0; j<tile.x1; j++) {
+                AovTimer<Channels> timer;
                 Vec3 color{0, 0, 0};
                 for (int k=0; k < samples; k++) {
-                    auto r = defaultSamplerInstance<UniformInSquare>().sample2d();
-                    float rx = r.x;
-                    float ry = r.y;
-                    float x = (float(j)+rx)/float(width);
-                    float y = (float(i)+ry)/float(height);
-                    auto ray = camera.shoot(x, y);
-                    color += trace(ray, 0);
+                    color += samplePixel<Channels>(i, j, k);
                 }
+                if constexpr (Channels != 0) timer.stop(aovPixels[i*width+j]);
                 color /= samples;
                 color = gamma(color);
                 pixels[(height-i-1)*width+j] = {color, 1};
@@ -47,19 +79,249 @@ namespace SimplePathTracer
         VertexTransformer vertexTransformer{};
         vertexTransformer.exec(spScene);
 
-        const auto taskNums = 8;
-        thread t[taskNums];
-        for (int i=0; i < taskNums; i++) {
-            t[i] = thread(&SimplePathTracerRenderer::renderTask,
-                this, pixels, width, height, i, taskNums);
+        if (restir && adaptiveSampling) {
+            getServer().logger.warning("ReSTIR is ignored with adaptive sampling");
+            restir = false;
+        }
+        if (progressive && adaptiveSampling) {
+            getServer().logger.warning("Progressive rendering is ignored with adaptive sampling");
+            progressive = false;
         }
-        for(int i=0; i < taskNums; i++) {
-            t[i].join();
+        // 时间复用只在渐进式渲染中进行, 非渐进式的ReSTIR每帧独立
+        restirTemporal = restir && progressive;
+        if (lightBVH) lightTree.build(scene.areaLightBuffer, true);
+        else if (lightSampling || restir) buildLightCdf();
+        pixelSampler = PixelSamplerCreator{}.create(samplerType);
+        if (denoise) denoisePixels.assign(size_t(width)*height, {});
+        if (aovChannels != 0) aovPixels.assign(size_t(width)*height, {});
+        if (restir) {
+            restirPixels.assign(size_t(width)*height, {});
+            restirHistory.assign(size_t(width)*height, {});
+            restirSpatial.assign(size_t(width)*height, {});
+        }
+
+        auto start = chrono::steady_clock::now();
+        if (adaptiveSampling) {
+            renderAdaptive(pixels);
         }
+        else if (progressive) {
+            renderProgressive(pixels);
+        }
+        else if (restir) {
+            renderRestir(pixels);
+        }
+        else {
+            dispatchAovs(aovChannels, [this, pixels]<unsigned int Channels>() {
+                scheduler.run([this, pixels](const Tile& tile, unsigned int) { renderTask<Channels>(pixels, tile); });
+            });
+        }
+        getServer().logger.log("Tile scheduler: " + scheduler.report());
+        double renderTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (denoise) denoiseImage(pixels, renderTime);
+        if (restir) {
+            getServer().logger.log("ReSTIR: " + to_string(restirCandidates) + " candidates, " + to_string(restirNeighbors)
+                + " neighbors in " + to_string(restirRadius) + " pixels, temporal reuse " + (restirTemporal ? "on" : "off"));
+            restirPixels.clear();
+            restirPixels.shrink_to_fit();
+            restirHistory.clear();
+            restirHistory.shrink_to_fit();
+            restirSpatial.clear();
+            restirSpatial.shrink_to_fit();
+        }
+        if (aovChannels != 0) {
+            aovs = FrameBuffer{width, height, aovChannels};
+            dispatchAovs(aovChannels, [this]<unsigned int Channels>() { writeAovs<Channels>(aovs, aovPixels); });
+            aovPixels.clear();
+            aovPixels.shrink_to_fit();
+        }
+        getServer().logger.log("Render time: " + to_string(renderTime)
+            + "s, light sampling " + (lightSampling ? "on" : "off") + (lightBVH ? " (light BVH)" : "") + ", max depth " + to_string(depth)
+            + ", russian roulette from depth " + to_string(russianRouletteDepth) + ", sampler " + samplerName());
         getServer().logger.log("Done...");
         return {pixels, width, height};
     }
 
+    void SimplePathTracerRenderer::PixelEstimate::add(const RGB& color) {
+        float luminance = glm::dot(color, Vec3{0.2126f, 0.7152f, 0.0722f});
+        n++;
+        mean += (color - mean) / float(n);
+        float delta = luminance - luminanceMean;
+        luminanceMean += delta / float(n);
+        m2 += delta * (luminance - luminanceMean);
+    }
+
+    float SimplePathTracerRenderer::PixelEstimate::relativeError() const {
+        if (n < 2) return FLOAT_INF;
+        float standardError = sqrt(m2 / float(n - 1) / float(n));
+        // 避免全黑像素的相对误差发散
+        return standardError / (luminanceMean + 0.01f);
+    }
+
+    template <unsigned int Channels>
+    void SimplePathTracerRenderer::adaptiveTask(const vector<unsigned int>& counts, const Tile& tile) {
+        for(int i=tile.y0; i<tile.y1; i++) {
+            for (int j=tile.x0; j<tile.x1; j++) {
+                auto index = i*width+j;
+                AovTimer<Channels> timer;
+                for (unsigned int k=0; k < counts[index]; k++) {
+                    estimates[index].add(samplePixel<Channels>(i, j, estimates[index].n));
+                }
+                if constexpr (Channels != 0) timer.stop(aovPixels[index]);
+            }
+        }
+    }
+
+    void SimplePathTracerRenderer::renderAdaptive(RGBA* pixels) {
+        getServer().control.setStoppable(true);
+        size_t pixelNums = size_t(width)*height;
+        estimates.assign(pixelNums, {});
+        vector<unsigned int> counts(pixelNums, minSamples);
+        auto run = [this, &counts]() {
+            dispatchAovs(aovChannels, [this, &counts]<unsigned int Channels>() {
+                scheduler.run([this, &counts](const Tile& tile, unsigned int) { adaptiveTask<Channels>(counts, tile); });
+            });
+        };
+        run();
+
+        // 剩余预算分多轮, 每轮按相对误差成比例分配, 误差在每轮之后重新估计
+        const size_t budget = size_t(samples)*pixelNums;
+        size_t spent = size_t(minSamples)*pixelNums;
+        const size_t roundSamples = glm::max(pixelNums, budget/8);
+        unsigned int rounds = 0;
+        vector<float> errors(pixelNums);
+        vector<unsigned int> order(pixelNums);
+        while (spent < budget) {
+            size_t round = glm::min(roundSamples, budget - spent);
+            double errorSum = 0;
+            for (size_t p=0; p < pixelNums; p++) {
+                errors[p] = estimates[p].n < maxSamples ? estimates[p].relativeError() : 0.f;
+                errorSum += errors[p];
+            }
+            if (errorSum <= 0) break;
+            size_t total = 0;
+            for (size_t p=0; p < pixelNums; p++) {
+                double share = double(round) * errors[p] / errorSum;
+                counts[p] = (unsigned int)glm::min(double(maxSamples - estimates[p].n), floor(share));
+                total += counts[p];
+            }
+            // 向下取整剩下的采样按误差从大到小逐个分给未达上限的像素
+            size_t candidates = 0;
+            for (size_t p=0; p < pixelNums; p++) {
+                if (errors[p] > 0) order[candidates++] = (unsigned int)p;
+            }
+            sort(order.begin(), order.begin() + candidates,
+                [&errors](unsigned int a, unsigned int b) { return errors[a] > errors[b]; });
+            bool assigned = true;
+            while (total < round && assigned) {
+                assigned = false;
+                for (size_t k=0; k < candidates && total < round; k++) {
+                    auto p = order[k];
+                    if (estimates[p].n + counts[p] < maxSamples) {
+                        counts[p]++;
+                        total++;
+                        assigned = true;
+                    }
+                }
+            }
+            if (total == 0) break;
+            run();
+            spent += total;
+            rounds++;
+            if (getServer().control.stopRequested()) {
+                getServer().logger.warning("Adaptive sampling stopped after round " + to_string(rounds));
+                break;
+            }
+        }
+
+        unsigned int fewest = maxSamples, most = 0;
+        for (size_t p=0; p < pixelNums; p++) {
+            auto& e = estimates[p];
+            fewest = glm::min(fewest, e.n);
+            most = glm::max(most, e.n);
+            int i = int(p) / int(width), j = int(p) % int(width);
+            pixels[(height-i-1)*width+j] = {gamma(e.mean), 1};
+        }
+        getServer().logger.log("Adaptive sampling: " + to_string(double(spent)/double(pixelNums)) + " spp in "
+            + to_string(rounds) + " rounds, " + to_string(fewest) + "~" + to_string(most) + " spp per pixel");
+        estimates.clear();
+        estimates.shrink_to_fit();
+    }
+
+    // 每个像素再采样count次, 写出前total次采样的平均
+    template <unsigned int Channels>
+    void SimplePathTracerRenderer::progressiveTask(RGBA* pixels, unsigned int total, unsigned int count, const Tile& tile) {
+        for(int i=tile.y0; i<tile.y1; i++) {
+            for (int j=tile.x0; j<tile.x1; j++) {
+                auto& sum = accumulation[i*width+j];
+                AovTimer<Channels> timer;
+                for (unsigned int k=0; k < count; k++) {
+                    sum += samplePixel<Channels>(i, j, total - count + k);
+                }
+                if constexpr (Channels != 0) timer.stop(aovPixels[i*width+j]);
+                pixels[(height-i-1)*width+j] = {gamma(sum / float(total)), 1};
+            }
+        }
+    }
+
+    void SimplePathTracerRenderer::renderProgressive(RGBA* pixels) {
+        getServer().control.setStoppable(true);
+        accumulation.assign(size_t(width)*height, RGB{0});
+        auto start = chrono::steady_clock::now();
+        unsigned int done = 0;
+        unsigned int passes = 0;
+        while (done < samples) {
+            unsigned int count = glm::min(passSamples, samples - done);
+            if (restir) {
+                for (unsigned int k=0; k < count; k++) restirFrame(pixels, done + k);
+            }
+            else {
+                dispatchAovs(aovChannels, [this, pixels, total = done + count, count]<unsigned int Channels>() {
+                    scheduler.run([this, pixels, total, count](const Tile& tile, unsigned int) {
+                        progressiveTask<Channels>(pixels, total, count, tile);
+                    });
+                });
+            }
+            done += count;
+            passes++;
+            getServer().screen.set(pixels, width, height);
+            if (passes == 1) {
+                getServer().logger.log("First pass (" + to_string(count) + " spp) in "
+                    + to_string(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()) + "ms");
+            }
+            if (getServer().control.stopRequested()) {
+                getServer().logger.warning("Stopped at " + to_string(done) + "/" + to_string(samples) + " spp");
+                break;
+            }
+        }
+        accumulation.clear();
+        accumulation.shrink_to_fit();
+    }
+
+    // 所有采样结束后的后处理, 用滤波后的颜色覆盖pixels
+    void SimplePathTracerRenderer::denoiseImage(RGBA* pixels, double renderTime) {
+        Denoiser denoiser{width, height, denoiseIterations, scene.renderOption.threads};
+        auto colors = denoiser.run(denoisePixels);
+        for (int i=0; i < height; i++) {
+            for (int j=0; j < width; j++) {
+                pixels[(height-i-1)*width+j] = {gamma(colors[i*width+j]), 1};
+            }
+        }
+        getServer().logger.log("Denoise: " + to_string(denoiseIterations) + " iterations in "
+            + to_string(denoiser.milliseconds()) + "ms, " + to_string(denoiser.milliseconds() / 10 / renderTime) + "% of render time");
+        denoisePixels.clear();
+        denoisePixels.shrink_to_fit();
+    }
+
+    string SimplePathTracerRenderer::samplerName() const {
+        switch (samplerType)
+        {
+        case RenderSettings::SamplerType::INDEPENDENT: return "independent";
+        case RenderSettings::SamplerType::HALTON: return "halton";
+        case RenderSettings::SamplerType::PMJ02: return "pmj02";
+        default: return "sobol";
+        }
+    }
+
     void SimplePathTracerRenderer::release(const RenderResult& r) {
         auto [p, w, h] = r;
         delete[] p;
@@ -92,48 +354,166 @@ namespace SimplePathTracer
         return closestHit; 
     }
     
-    tuple<float, Vec3> SimplePathTracerRenderer::closestHitLight(const Ray& r) {
+    tuple<float, Vec3, int> SimplePathTracerRenderer::closestHitLight(const Ray& r) {
         Vec3 v = {};
+        int index = -1;
         HitRecord closest = getHitRecord(FLOAT_INF, {}, {}, {});
-        for (auto& a : scene.areaLightBuffer) {
+        if (lightBVH) {
+            lightTree.intersect(r.origin, r.direction, FLOAT_INF, [&](unsigned int i, float tMax) {
+                auto hitRecord = Intersection::xAreaLight(r, scene.areaLightBuffer[i], 0.000001, tMax);
+                if (!hitRecord || hitRecord->t >= tMax) return tMax;
+                closest = hitRecord;
+                v = scene.areaLightBuffer[i].radiance;
+                index = int(i);
+                return hitRecord->t;
+            });
+            return { closest->t, v, index };
+        }
+        for (int i = 0; i < scene.areaLightBuffer.size(); i++) {
+            auto& a = scene.areaLightBuffer[i];
             auto hitRecord = Intersection::xAreaLight(r, a, 0.000001, closest->t);
             if (hitRecord && closest->t > hitRecord->t) {
                 closest = hitRecord;
                 v = a.radiance;
+                index = i;
             }
         }
-        return { closest->t, v };
-    }
-
-    RGB SimplePathTracerRenderer::trace(const Ray& r, int currDepth) {
-        if (currDepth == depth) return scene.ambient.constant;
-        auto hitObject = closestHitObject(r);
-        auto [ t, emitted ] = closestHitLight(r);
-        // hit object
-        if (hitObject && hitObject->t < t) {
-            auto mtlHandle = hitObject->material;
-            auto scattered = shaderPrograms[mtlHandle.index()]->shade(r, hitObject->hitPoint, hitObject->normal);
-            auto scatteredRay = scattered.ray;
-            auto attenuation = scattered.attenuation;
-            auto emitted = scattered.emitted;
-            auto next = trace(scatteredRay, currDepth+1);
-            float n_dot_in = glm::dot(hitObject->normal, scatteredRay.direction);
-            float pdf = scattered.pdf;
-            /**
-             * emitted      - Le(p, w_0)
-             * next         - Li(p, w_i)
-             * n_dot_in     - cos<n, w_i>
-             * atteunation  - BRDF
-             * pdf          - p(w)
-             **/
-            return emitted + attenuation * next * n_dot_in / pdf;
-        }
-        // 
-        else if (t != FLOAT_INF) {
-            return emitted;
+        return { closest->t, v, index };
+    }
+
+    void SimplePathTracerRenderer::buildLightCdf() {
+        lightCdf.clear();
+        float sum = 0;
+        for (auto& a : scene.areaLightBuffer) {
+            float luminance = glm::dot(a.radiance, Vec3{0.2126f, 0.7152f, 0.0722f});
+            sum += luminance * glm::length(glm::cross(a.u, a.v));
+            lightCdf.push_back(sum);
         }
-        else {
-            return Vec3{0};
+        if (sum <= 0) {
+            lightCdf.clear();
+            return;
+        }
+        for (auto& c : lightCdf) c /= sum;
+    }
+
+    // 从r.origin出发在距离t处打到光源light的立体角概率密度
+    // 光源两面都发光, 与closestHitLight一致
+    float SimplePathTracerRenderer::lightPdf(const Ray& r, float t, int light, const Vec3& normal) const {
+        if (light < 0 || light >= scene.areaLightBuffer.size()) return 0.f;
+        if (!lightBVH && lightCdf.empty()) return 0.f;
+        auto& a = scene.areaLightBuffer[light];
+        Vec3 lightNormal = glm::cross(a.u, a.v);
+        float area = glm::length(lightNormal);
+        float cosLight = fabs(glm::dot(lightNormal, r.direction)) / area;
+        if (cosLight <= 0) return 0.f;
+        float select = lightBVH ? lightTree.pmf(r.origin, normal, light)
+            : lightCdf[light] - (light > 0 ? lightCdf[light - 1] : 0.f);
+        return select * t * t / (cosLight * area);
+    }
+
+    RGB SimplePathTracerRenderer::sampleLight(const HitRecordBase& hit, const Shader& shader, SampleStream& stream) {
+        int light = -1;
+        float u = stream.next1d();
+        auto uv = stream.next2d();
+        if (lightBVH) {
+            light = lightTree.sample(hit.hitPoint, hit.normal, u).first;
+        }
+        else if (!lightCdf.empty()) {
+            light = int(upper_bound(lightCdf.begin(), lightCdf.end(), u) - lightCdf.begin());
+            light = min(light, int(lightCdf.size()) - 1);
+        }
+        if (light < 0) return Vec3{0};
+        auto& a = scene.areaLightBuffer[light];
+        Vec3 point = a.position + uv.x*a.u + uv.y*a.v;
+
+        Vec3 toLight = point - hit.hitPoint;
+        float dist = glm::length(toLight);
+        if (dist <= 0) return Vec3{0};
+        Ray shadowRay{hit.hitPoint, toLight / dist};
+        float cosSurface = glm::dot(hit.normal, shadowRay.direction);
+        if (cosSurface <= 0) return Vec3{0};
+        float pdfLight = lightPdf(shadowRay, dist, light, hit.normal);
+        if (pdfLight <= 0) return Vec3{0};
+        auto occluder = closestHitObject(shadowRay);
+        if (occluder && occluder->t < dist * (1 - 1e-4f)) return Vec3{0};
+
+        float pdfBsdf = shader.pdf(shadowRay.direction, hit.normal);
+        return shader.evaluate(shadowRay.direction, hit.normal) * a.radiance * cosSurface / pdfLight
+            * powerHeuristic(pdfLight, pdfBsdf);
+    }
+
+    RGB SimplePathTracerRenderer::trace(const Ray& ray, SampleStream& stream, SurfaceFeature* feature, RestirPixel* primary) {
+        RGB radiance{0};
+        RGB throughput{1};
+        Ray r = ray;
+        // 上一次BSDF采样的概率密度, 打到光源时用于MIS, 0表示不做MIS
+        float bsdfPdf = 0.f;
+        Vec3 prevNormal{0};
+        // 首个交点的直接光照由ReSTIR计算, BSDF采样打到光源时不再计入
+        bool skipLight = false;
+        for (int currDepth = 0; ; currDepth++) {
+            stream.startBounce(currDepth);
+            if (currDepth == depth) {
+                radiance += throughput * scene.ambient.constant;
+                break;
+            }
+            auto hitObject = closestHitObject(r);
+            auto [ t, emitted, light ] = closestHitLight(r);
+            // hit object
+            if (hitObject && hitObject->t < t) {
+                auto mtlHandle = hitObject->material;
+                auto& shader = *shaderPrograms[mtlHandle.index()];
+                if (currDepth == 0 && feature != nullptr) {
+                    auto diffuseColor = scene.materials[mtlHandle.index()].getProperty<Property::Wrapper::RGBType>("diffuseColor");
+                    *feature = {diffuseColor ? (*diffuseColor).value : RGB{1}, hitObject->normal, hitObject->t, int(mtlHandle.index())};
+                }
+                bool restirVertex = currDepth == 0 && primary != nullptr;
+                if (restirVertex) {
+                    primary->point = hitObject->hitPoint;
+                    primary->normal = hitObject->normal;
+                    primary->depth = hitObject->t;
+                    primary->material = int(mtlHandle.index());
+                }
+                auto scattered = shader.shade(r, hitObject->hitPoint, hitObject->normal, stream.next2d());
+                auto attenuation = scattered.attenuation;
+                float pdf = scattered.pdf;
+                radiance += throughput * scattered.emitted;
+                // 最后一个交点发出的光线不再计入光源, 光源采样也不做, 保持两种策略的路径长度一致
+                if (lightSampling && currDepth + 1 < depth && !restirVertex) {
+                    radiance += throughput * sampleLight(*hitObject, shader, stream);
+                }
+                if (pdf <= 0) break;
+                float n_dot_in = glm::dot(hitObject->normal, scattered.ray.direction);
+                /**
+                 * throughput   - 路径到当前交点的贡献 f*cos/p 的乘积
+                 * n_dot_in     - cos<n, w_i>
+                 * atteunation  - BRDF
+                 * pdf          - p(w)
+                 **/
+                throughput *= attenuation * n_dot_in / pdf;
+                // russian roulette: 存活概率取throughput的最大分量, 存活的路径除以该概率保持无偏
+                if (currDepth + 1 >= russianRouletteDepth) {
+                    float survive = glm::min(0.95f, glm::max(throughput.r, glm::max(throughput.g, throughput.b)));
+                    if (stream.next1d() >= survive) break;
+                    throughput /= survive;
+                }
+                bsdfPdf = lightSampling ? pdf : 0.f;
+                prevNormal = hitObject->normal;
+                skipLight = restirVertex;
+                r = scattered.ray;
+            }
+            // 
+            else if (t != FLOAT_INF) {
+                if (skipLight) break;
+                // BSDF采样打到光源, 按MIS权重计入; 摄像机光线直接看到光源时权重为1
+                float weight = bsdfPdf > 0 ? powerHeuristic(bsdfPdf, lightPdf(r, t, light, prevNormal)) : 1.f;
+                radiance += throughput * emitted * weight;
+                break;
+            }
+            else {
+                break;
+            }
         }
+        return radiance;
     }
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "samplers/PMJ02Sampler.hpp"
+
+#include <random>
+#include <cmath>
+
+namespace SimplePathTracer
+{
+    namespace
+    {
+        struct Point2d
+        {
+            double x, y;
+        };
+
+        // n = 2^m 个点的所有初等区间的占用情况, shape a 为 2^a * 2^(m-a) 的划分
+        class Strata
+        {
+        private:
+            uint32_t m;
+            vector<vector<bool>> occupied;
+
+            uint32_t cell(uint32_t a, uint32_t xs, uint32_t ys) const {
+                return ((ys >> a) << a) | (xs >> (m - a));
+            }
+        public:
+            void reset(uint32_t log2n) {
+                m = log2n;
+                occupied.assign(m + 1, vector<bool>(size_t(1) << m, false));
+            }
+
+            // xs, ys 为最细一维划分上的下标
+            bool free(uint32_t xs, uint32_t ys) const {
+                for (uint32_t a = 0; a <= m; a++) {
+                    if (occupied[a][cell(a, xs, ys)]) return false;
+                }
+                return true;
+            }
+
+            void mark(uint32_t xs, uint32_t ys) {
+                for (uint32_t a = 0; a <= m; a++) {
+                    occupied[a][cell(a, xs, ys)] = true;
+                }
+            }
+        };
+
+        class Generator
+        {
+        private:
+            mt19937 e;
+            uniform_real_distribution<double> u;
+            Strata strata;
+            uint32_t n;
+        public:
+            vector<Point2d> points;
+
+            explicit Generator(uint32_t seed)
+                : e             (seed)
+                , u             (0, 1)
+                , strata        ()
+                , n             (0)
+            {}
+
+            // 接下来共有2^m个点
+            void begin(uint32_t m) {
+                n = 1u << m;
+                strata.reset(m);
+                for (auto& p : points) strata.mark(uint32_t(p.x * n), uint32_t(p.y * n));
+            }
+
+            // 在子格 [x0, x0+w) * [y0, y0+w) 内找一个所有初等区间都未被占用的位置
+            // 先随机尝试, 失败后枚举子格内所有位置; 无解时返回false
+            bool place(double x0, double y0, double w) {
+                uint32_t k = uint32_t(w * n + 0.5);
+                uint32_t bx = uint32_t(x0 * n + 0.5);
+                uint32_t by = uint32_t(y0 * n + 0.5);
+                auto add = [this](uint32_t xs, uint32_t ys) {
+                    strata.mark(xs, ys);
+                    // 在最细的格子内抖动, 不落在格子的右上边界上
+                    points.push_back({ (xs + u(e) * 0.999999) / n, (ys + u(e) * 0.999999) / n });
+                };
+                for (int t = 0; t < 64; t++) {
+                    uint32_t xs = bx + e() % k, ys = by + e() % k;
+                    if (strata.free(xs, ys)) {
+                        add(xs, ys);
+                        return true;
+                    }
+                }
+                vector<pair<uint32_t, uint32_t>> candidates;
+                for (uint32_t i = 0; i < k; i++) for (uint32_t j = 0; j < k; j++) {
+                    if (strata.free(bx + i, by + j)) candidates.push_back({ bx + i, by + j });
+                }
+                if (candidates.empty()) return false;
+                auto [xs, ys] = candidates[e() % candidates.size()];
+                add(xs, ys);
+                return true;
+            }
+
+            uint32_t random() {
+                return e();
+            }
+
+            double uniform() {
+                return u(e) * 0.999999;
+            }
+        };
+
+        // 点p在 side*side 网格中的格子和所在的四分之一子格
+        void locate(const Point2d& p, uint32_t side, uint32_t& cx, uint32_t& cy, uint32_t& hx, uint32_t& hy) {
+            cx = uint32_t(p.x * side);
+            cy = uint32_t(p.y * side);
+            hx = uint32_t(p.x * 2 * side) & 1;
+            hy = uint32_t(p.y * 2 * side) & 1;
+        }
+
+        bool generatePoints(Generator& g, uint32_t count) {
+            g.points.clear();
+            g.points.push_back({ g.uniform(), g.uniform() });
+            uint32_t m = 0;
+            while (g.points.size() < count) {
+                // n*n -> 2n*n: 每个旧点所在格子的对角子格放一个新点
+                uint32_t size = uint32_t(g.points.size());
+                uint32_t side = uint32_t(sqrt(double(size)) + 0.5);
+                double w = 0.5 / side;
+                g.begin(++m);
+                for (uint32_t s = 0; s < size; s++) {
+                    uint32_t cx, cy, hx, hy;
+                    locate(g.points[s], side, cx, cy, hx, hy);
+                    if (!g.place((2 * cx + 1 - hx) * w, (2 * cy + 1 - hy) * w, w)) return false;
+                }
+                if (g.points.size() >= count) break;
+                // 2n*n -> 4n*n: 每个格子剩下的两个子格各放一个点, 先放哪一个随机选择
+                size = uint32_t(g.points.size());
+                g.begin(++m);
+                vector<Point2d> second;
+                for (uint32_t s = 0; s < size / 2; s++) {
+                    uint32_t cx, cy, hx, hy;
+                    locate(g.points[s], side, cx, cy, hx, hy);
+                    uint32_t fx = hx, fy = hy;
+                    if (g.random() & 1) fx = 1 - hx;
+                    else fy = 1 - hy;
+                    if (!g.place((2 * cx + fx) * w, (2 * cy + fy) * w, w)) return false;
+                    second.push_back({ (2 * cx + 1 - fx) * w, (2 * cy + 1 - fy) * w });
+                }
+                for (auto& c : second) {
+                    if (!g.place(c.x, c.y, w)) return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    auto PMJ02Sampler::generate(uint32_t seed) -> Table {
+        Generator g{ seed };
+        // 少数情况下子格内没有合法位置, 换随机数重新生成
+        while (!generatePoints(g, tableSize));
+        Table table;
+        table.reserve(tableSize);
+        for (auto& p : g.points) {
+            table.push_back({ uint32_t(p.x * 0x1p32), uint32_t(p.y * 0x1p32) });
+        }
+        return table;
+    }
+
+    const vector<PMJ02Sampler::Table>& PMJ02Sampler::tables() {
+        static const vector<Table> t = []() {
+            vector<Table> sets;
+            for (uint32_t s = 0; s < setNums; s++) sets.push_back(generate(s));
+            return sets;
+        }();
+        return t;
+    }
+
+    PMJ02Sampler::PMJ02Sampler() {
+        // 在渲染开始前生成, 不计入第一个样本的时间
+        tables();
+    }
+
+    float PMJ02Sampler::get1d(uint32_t pixel, uint32_t index, uint32_t dim) const {
+        uint64_t h = hashValues(pixel, dim, 0);
+        auto& table = tables()[(h + index / tableSize) % setNums];
+        uint64_t scramble = mixBits(h);
+        auto& p = table[shuffleIndex(index % tableSize, uint32_t(scramble))];
+        return toUnitFloat(nestedUniformScramble(p.x, uint32_t(h >> 32)));
+    }
+
+    Vec2 PMJ02Sampler::get2d(uint32_t pixel, uint32_t index, uint32_t dim) const {
+        uint64_t h = hashValues(pixel, dim, 1);
+        auto& table = tables()[(h + index / tableSize) % setNums];
+        uint64_t scramble = mixBits(h);
+        auto& p = table[shuffleIndex(index % tableSize, uint32_t(h >> 32))];
+        return {
+            toUnitFloat(nestedUniformScramble(p.x, uint32_t(scramble))),
+            toUnitFloat(nestedUniformScramble(p.y, uint32_t(scramble >> 32)))
+        };
+    }
+}
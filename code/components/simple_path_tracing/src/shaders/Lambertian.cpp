@@ -1,10 +1,26 @@
 #include "shaders/Lambertian.hpp"
-#include "samplers/SamplerInstance.hpp"
 
 #include "Onb.hpp"
 
 namespace SimplePathTracer
 {
+    // 单位正方形到单位圆盘的同心映射(Shirley-Chiu), 保持样本的分层
+    inline Vec2 concentricDisk(const Vec2& sample) {
+        float x = 2*sample.x - 1;
+        float y = 2*sample.y - 1;
+        if (x == 0 && y == 0) return {0, 0};
+        float r, theta;
+        if (fabs(x) > fabs(y)) {
+            r = x;
+            theta = PI/4 * (y/x);
+        }
+        else {
+            r = y;
+            theta = PI/2 - PI/4 * (x/y);
+        }
+        return {r*cos(theta), r*sin(theta)};
+    }
+
     Lambertian::Lambertian(Material& material, vector<Texture>& textures)
         : Shader                (material, textures)
     {
@@ -12,9 +28,13 @@ namespace SimplePathTracer
         if (diffuseColor) albedo = (*diffuseColor).value;
         else albedo = {1, 1, 1};
     }
-    Scattered Lambertian::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal) const {
+    Scattered Lambertian::shade(const Ray& ray, const Vec3& hitPoint, const Vec3& normal, const Vec2& sample) const {
         Vec3 origin = hitPoint;
-        Vec3 random = defaultSamplerInstance<HemiSphere>().sample3d();
+        // 余弦加权(Malley): 圆盘上均匀取点再投影到半球, p(w) = cos/PI
+        // 与渲染方程中的cos项抵消, throughput只乘albedo
+        auto d = concentricDisk(sample);
+        float z = sqrt(glm::max(0.f, 1 - d.x*d.x - d.y*d.y));
+        Vec3 random{d.x, d.y, z};
         // if (normal == Vec3{0, 0, 1}) {
         //     direction = random;
         // }
@@ -33,7 +53,7 @@ namespace SimplePathTracer
         Onb onb{normal};
         Vec3 direction = glm::normalize(onb.local(random));
 
-        float pdf = 1/(2*PI);
+        float pdf = glm::dot(direction, normal) / PI;
 
         auto attenuation = albedo / PI;
 
@@ -44,4 +64,12 @@ namespace SimplePathTracer
             pdf
         };
     }
+
+    Vec3 Lambertian::evaluate(const Vec3& in, const Vec3& normal) const {
+        return glm::dot(in, normal) > 0 ? albedo / PI : Vec3{0};
+    }
+
+    float Lambertian::pdf(const Vec3& in, const Vec3& normal) const {
+        return glm::max(0.f, glm::dot(in, normal)) / PI;
+    }
 }
\ No newline at end of file
@@ -19,7 +19,66 @@ namespace NRenderer
 		unsigned int samplesPerPixel;
 		RenderSettings::Acceleration acc;
 		unsigned int photonsPerLight;
+		// 大于0时按光源功率分配的光子总数, 取代photonsPerLight
+		unsigned int photonBudget;
 		unsigned int neighborPhotons;
+		// 近似k近邻搜索的epsilon, 0为精确搜索
+		float knnEpsilon;
+		// 光子图(含树节点和焦散光子图)的内存预算(MB), 全局光子图超出后写入临时文件, 0为不限制; 峰值的构成见PhotonSpill
+		unsigned int photonMemoryMB;
+		// 焦散光子图, photons为0时不使用
+		unsigned int causticPhotonsPerLight;
+		unsigned int causticNeighborPhotons;
+		// 直接光照用阴影光线计算, 光子图只负责间接光照
+		bool directLighting;
+		unsigned int shadowRays;
+		// final gathering + 辐照度缓存
+		bool finalGather;
+		unsigned int gatherRays;
+		float irradianceCacheAccuracy;
+		// 预计算辐照度光子, 渲染时只做一次最近邻查询
+		bool precomputeIrradiance;
+		// 光子图同时保存到临时文件, 之后可以通过内存映射读入
+		bool savePhotonMap;
+		// 漫反射交点按Morton码排序后分批做k近邻查询
+		bool batchedGather;
+		// 用投影图把光子限制在能打到几何体的方向
+		bool projectionMaps;
+		// 光子发射使用Halton序列代替伪随机数
+		bool qmcEmission;
+		// stochastic progressive photon mapping
+		bool sppm;
+		unsigned int sppmPasses;
+		unsigned int sppmPhotonsPerPass;
+		float sppmInitialRadius;
+		// 路径追踪: 在漫反射交点对面光源采样, 与BSDF采样做MIS
+		bool lightSampling;
+		// 用光源层次结构按着色点选择光源并加速光线与光源求交, 关闭时按功率选择、逐个求交
+		bool lightBVH;
+		// 路径追踪: 从该深度开始按路径权重做russian roulette, depth为最大深度
+		unsigned int russianRouletteDepth;
+		// 自适应采样: samplesPerPixel为平均每像素的预算, 每个像素在[minSamples, maxSamples]之间按误差分配
+		bool adaptiveSampling;
+		unsigned int minSamples;
+		unsigned int maxSamples;
+		// 渐进式渲染: 每一轮每像素passSamples次采样, 每轮结束后更新画面
+		bool progressive;
+		unsigned int passSamples;
+		// 分块渲染: 块的边长, 线程数(0为hardware_concurrency)
+		unsigned int tileSize;
+		unsigned int threads;
+		// 路径追踪的采样器
+		RenderSettings::SamplerType sampler;
+		// 降噪: 渲染结束后用首个交点的albedo、法线和深度引导à-trous滤波, 迭代denoiseIterations次
+		bool denoise;
+		unsigned int denoiseIterations;
+		// 路径追踪: 首个交点的直接光照用ReSTIR重采样, 候选数、空间复用的邻居数和半径(像素), 渐进式渲染时做时间复用
+		bool restir;
+		unsigned int restirCandidates;
+		unsigned int restirNeighbors;
+		float restirRadius;
+		// 颜色之外要输出的通道(深度、法线等), 渲染器只写请求的通道
+		unsigned int aovChannels;
 		RenderOption()
 			: width(500)
 			, height(500)
@@ -27,7 +86,44 @@ namespace NRenderer
 			, samplesPerPixel(16)
 			, acc(RenderSettings::Acceleration::NONE)
 			, photonsPerLight(10000)
+			, photonBudget(0)
 			, neighborPhotons(250)
+			, knnEpsilon(0.f)
+			, photonMemoryMB(0)
+			, causticPhotonsPerLight(0)
+			, causticNeighborPhotons(80)
+			, directLighting(false)
+			, shadowRays(4)
+			, finalGather(false)
+			, gatherRays(64)
+			, irradianceCacheAccuracy(0.2f)
+			, precomputeIrradiance(false)
+			, savePhotonMap(false)
+			, batchedGather(false)
+			, projectionMaps(false)
+			, qmcEmission(false)
+			, sppm(false)
+			, sppmPasses(64)
+			, sppmPhotonsPerPass(20000)
+			, sppmInitialRadius(10.f)
+			, lightSampling(false)
+			, lightBVH(false)
+			, russianRouletteDepth(3)
+			, adaptiveSampling(false)
+			, minSamples(8)
+			, maxSamples(256)
+			, progressive(false)
+			, passSamples(1)
+			, tileSize(16)
+			, threads(0)
+			, sampler(RenderSettings::SamplerType::INDEPENDENT)
+			, denoise(false)
+			, denoiseIterations(5)
+			, restir(false)
+			, restirCandidates(32)
+			, restirNeighbors(5)
+			, restirRadius(10.f)
+			, aovChannels(0)
 		{}
 	};
 
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __NR_FRAME_BUFFER_HPP__
+#define __NR_FRAME_BUFFER_HPP__
+
+#include "geometry/vec.hpp"
+#include <vector>
+
+namespace NRenderer
+{
+    using namespace std;
+
+    // 帧缓冲的通道(AOV), 除COLOR外都是原始数值, 显示时由Screen映射到[0, 1]
+    //  DEPTH: 首个交点的t;  NORMAL: 首个交点的法线;  ALBEDO: 首个交点的漫反射颜色
+    //  MATERIAL_ID: 首个交点的材质下标, 没有交点为-1;  SAMPLE_COUNT: 采样数;  RENDER_TIME: 渲染该像素的微秒数
+    // 标量通道的值写在r, g, b三个分量上
+    enum class Channel : unsigned int
+    {
+        COLOR = 0,
+        DEPTH,
+        NORMAL,
+        ALBEDO,
+        MATERIAL_ID,
+        SAMPLE_COUNT,
+        RENDER_TIME
+    };
+    constexpr unsigned int CHANNEL_NUMS = 7;
+
+    constexpr unsigned int channelBit(Channel c) {
+        return 1u << static_cast<unsigned int>(c);
+    }
+
+    constexpr bool hasChannel(unsigned int mask, Channel c) {
+        return (mask & channelBit(c)) != 0;
+    }
+
+    inline const char* channelName(Channel c) {
+        const char* names[CHANNEL_NUMS] = { "Color", "Depth", "Normal", "Albedo", "Material ID", "Sample Count", "Render Time" };
+        return names[static_cast<unsigned int>(c)];
+    }
+
+    // 多通道帧缓冲, 每个通道一张 width*height 的图, 行序与颜色缓冲相同
+    // 只为mask中的通道分配内存
+    class FrameBuffer
+    {
+    private:
+        unsigned int width;
+        unsigned int height;
+        unsigned int mask;
+        vector<RGBA> channels[CHANNEL_NUMS];
+    public:
+        FrameBuffer()
+            : width             (0)
+            , height            (0)
+            , mask              (0)
+        {}
+        FrameBuffer(unsigned int width, unsigned int height, unsigned int mask)
+            : width             (width)
+            , height            (height)
+            , mask              (mask)
+        {
+            for (unsigned int c = 0; c < CHANNEL_NUMS; c++) {
+                if (hasChannel(mask, Channel(c))) channels[c].assign(size_t(width) * height, RGBA{ 0, 0, 0, 1 });
+            }
+        }
+
+        unsigned int getWidth() const { return width; }
+        unsigned int getHeight() const { return height; }
+        unsigned int getMask() const { return mask; }
+        bool has(Channel c) const { return hasChannel(mask, c); }
+
+        // 通道不存在时返回nullptr
+        RGBA* data(Channel c) {
+            return has(c) ? channels[static_cast<unsigned int>(c)].data() : nullptr;
+        }
+        const RGBA* data(Channel c) const {
+            return has(c) ? channels[static_cast<unsigned int>(c)].data() : nullptr;
+        }
+
+        // 复制other中的所有通道, 覆盖同名通道; 大小不同时忽略
+        void merge(const FrameBuffer& other) {
+            if (other.width != width || other.height != height) return;
+            for (unsigned int c = 0; c < CHANNEL_NUMS; c++) {
+                if (other.has(Channel(c))) channels[c] = other.channels[c];
+            }
+            mask |= other.mask;
+        }
+    };
+} // namespace NRenderer
+
+#endif
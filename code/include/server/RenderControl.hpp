@@ -0,0 +1,30 @@
+#pragma once
+#ifndef __NR_RENDER_CONTROL_HPP__
+#define __NR_RENDER_CONTROL_HPP__
+
+#include "common/macros.hpp"
+#include <atomic>
+
+namespace NRenderer
+{
+    using namespace std;
+    // UI线程请求停止, 渲染线程在每一轮结束时检查, 保留已经收敛的结果
+    // 只有分轮渲染的模式会检查, 它们开始时调用setStoppable, UI据此决定是否显示Stop
+    class DLL_EXPORT RenderControl
+    {
+    private:
+        atomic<bool> stop;
+        atomic<bool> stoppable;
+    public:
+        RenderControl();
+        RenderControl(const RenderControl&) = delete;
+        ~RenderControl() = default;
+        void requestStop();
+        void reset();
+        bool stopRequested() const;
+        void setStoppable(bool value);
+        bool isStoppable() const;
+    };
+} // namespace NRenderer
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "geometry/vec.hpp"
 #include "common/macros.hpp"
+#include "FrameBuffer.hpp"
 #include <mutex>
 
 namespace NRenderer
@@ -16,11 +17,24 @@ namespace NRenderer
         unsigned int height;
         mutable bool updated;
         mutable mutex mtx;
+        // 各通道的原始数值, pixels是当前选中通道映射后的结果
+        FrameBuffer frame;
+        Channel selected;
+        void updateDisplay();
     public:
         Screen();
         Screen(const Screen&) = delete;
         ~Screen();
+        // 设置颜色, 清除其他通道
         void set(RGBA* pixels, int width, int height);
+        // 在set之后追加其他通道, 大小必须与颜色一致
+        void setChannels(const FrameBuffer& aovs);
+        // 选中的通道不存在时显示颜色
+        void select(Channel c);
+        Channel getSelected() const;
+        unsigned int getChannelMask() const;
+        // 在锁内复制通道的原始数值, 不存在时返回空; 不返回指针, 以免set()/release()之后悬空
+        vector<RGBA> getChannel(Channel c) const;
         unsigned int getWidth() const;
         unsigned int getHeight() const;
         const RGBA* getPixels() const;
@@ -4,6 +4,7 @@
 
 #include "Screen.hpp"
 #include "Logger.hpp"
+#include "RenderControl.hpp"
 #include "component/ComponentFactory.hpp"
 
 namespace NRenderer
@@ -12,6 +13,7 @@ namespace NRenderer
     {
         Logger logger = {};
         Screen screen = {};
+        RenderControl control = {};
         ComponentFactory componentFactory = {};
         Server() = default;
     };
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef __NR_AOV_HPP__
+#define __NR_AOV_HPP__
+
+#include "geometry/vec.hpp"
+#include "server/FrameBuffer.hpp"
+
+#include <vector>
+#include <chrono>
+
+namespace NRenderer
+{
+    using namespace std;
+
+    // 一次采样在首个交点处的特征, 用于降噪和AOV
+    // depth为0表示没有打到物体表面(直接看到光源或背景)
+    struct SurfaceFeature
+    {
+        RGB albedo{ 1 };
+        Vec3 normal{ 0 };
+        float depth = 0;
+        int material = -1;
+    };
+
+    // 需要首个交点特征的通道
+    constexpr unsigned int FEATURE_CHANNELS = channelBit(Channel::DEPTH) | channelBit(Channel::NORMAL)
+        | channelBit(Channel::ALBEDO) | channelBit(Channel::MATERIAL_ID);
+    // 渲染器在颜色之外可以输出的通道
+    constexpr unsigned int AOV_CHANNELS = FEATURE_CHANNELS
+        | channelBit(Channel::SAMPLE_COUNT) | channelBit(Channel::RENDER_TIME);
+
+    // 每个像素的AOV累加值: 特征在打到表面的采样上取平均, 材质取第一个打到表面的采样
+    // 每个像素只在一个块里渲染, 不需要加锁
+    struct AovPixel
+    {
+        RGB albedo{ 0 };
+        Vec3 normal{ 0 };
+        float depth = 0;
+        unsigned int surfaces = 0;
+        int material = -1;
+        unsigned int samples = 0;
+        double microseconds = 0;
+
+        // 只累加Channels中的通道, 其余的在编译期去掉
+        template <unsigned int Channels>
+        void add(const SurfaceFeature& f) {
+            if constexpr (hasChannel(Channels, Channel::SAMPLE_COUNT)) samples++;
+            if constexpr ((Channels & FEATURE_CHANNELS) != 0) {
+                if (f.depth <= 0) return;
+                surfaces++;
+                if constexpr (hasChannel(Channels, Channel::DEPTH)) depth += f.depth;
+                if constexpr (hasChannel(Channels, Channel::NORMAL)) normal += f.normal;
+                if constexpr (hasChannel(Channels, Channel::ALBEDO)) albedo += f.albedo;
+                if constexpr (hasChannel(Channels, Channel::MATERIAL_ID)) {
+                    if (material < 0) material = f.material;
+                }
+            }
+        }
+    };
+
+    // 渲染一个像素的计时, RENDER_TIME关闭时为空操作
+    template <unsigned int Channels>
+    class AovTimer
+    {
+    private:
+        chrono::steady_clock::time_point start;
+    public:
+        AovTimer() {
+            if constexpr (hasChannel(Channels, Channel::RENDER_TIME)) start = chrono::steady_clock::now();
+        }
+        void stop(AovPixel& pixel) {
+            if constexpr (hasChannel(Channels, Channel::RENDER_TIME))
+                pixel.microseconds += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    // 把运行时的通道掩码转成模板参数, 对AOV_CHANNELS的每个子集实例化一次f.operator()<Channels>
+    // 渲染循环按Channels实例化后, 关闭的通道不产生任何代码
+    template <unsigned int Bit = 0, unsigned int Channels = 0, typename F>
+    void dispatchAovs(unsigned int mask, F&& f) {
+        if constexpr (Bit == CHANNEL_NUMS) {
+            f.template operator()<Channels>();
+        }
+        else if constexpr (!hasChannel(AOV_CHANNELS, Channel(Bit))) {
+            dispatchAovs<Bit + 1, Channels>(mask, f);
+        }
+        else if (hasChannel(mask, Channel(Bit))) {
+            dispatchAovs<Bit + 1, Channels | channelBit(Channel(Bit))>(mask, f);
+        }
+        else {
+            dispatchAovs<Bit + 1, Channels>(mask, f);
+        }
+    }
+
+    // 把累加值写入帧缓冲, 第i行写到height-i-1行, 与颜色缓冲一致
+    template <unsigned int Channels>
+    void writeAovs(FrameBuffer& frame, const vector<AovPixel>& aovs) {
+        unsigned int width = frame.getWidth(), height = frame.getHeight();
+        RGBA* depth = frame.data(Channel::DEPTH);
+        RGBA* normal = frame.data(Channel::NORMAL);
+        RGBA* albedo = frame.data(Channel::ALBEDO);
+        RGBA* material = frame.data(Channel::MATERIAL_ID);
+        RGBA* samples = frame.data(Channel::SAMPLE_COUNT);
+        RGBA* time = frame.data(Channel::RENDER_TIME);
+        for (unsigned int i = 0; i < height; i++) {
+            for (unsigned int j = 0; j < width; j++) {
+                auto& a = aovs[i * width + j];
+                size_t p = size_t(height - i - 1) * width + j;
+                float w = a.surfaces > 0 ? 1.f / float(a.surfaces) : 0.f;
+                if constexpr (hasChannel(Channels, Channel::DEPTH)) depth[p] = { Vec3{ a.depth * w }, 1 };
+                if constexpr (hasChannel(Channels, Channel::NORMAL)) {
+                    float l = glm::length(a.normal);
+                    normal[p] = { l > 0 ? a.normal / l : Vec3{ 0 }, 1 };
+                }
+                if constexpr (hasChannel(Channels, Channel::ALBEDO)) albedo[p] = { a.albedo * w, 1 };
+                if constexpr (hasChannel(Channels, Channel::MATERIAL_ID)) material[p] = { Vec3{ float(a.material) }, 1 };
+                if constexpr (hasChannel(Channels, Channel::SAMPLE_COUNT)) samples[p] = { Vec3{ float(a.samples) }, 1 };
+                if constexpr (hasChannel(Channels, Channel::RENDER_TIME)) time[p] = { Vec3{ float(a.microseconds) }, 1 };
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,289 @@
+#pragma once
+#ifndef __NR_DENOISER_HPP__
+#define __NR_DENOISER_HPP__
+
+#include "geometry/vec.hpp"
+#include "TileScheduler.hpp"
+#include "Aov.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <algorithm>
+
+namespace NRenderer
+{
+    using namespace std;
+
+    // 降噪器的输入, 每个像素累加自己的所有采样
+    struct DenoisePixel
+    {
+        RGB color{ 0 };
+        // 亮度的平方和, 用于估计均值的方差
+        float luminance2 = 0;
+        RGB albedo{ 0 };
+        Vec3 normal{ 0 };
+        float depth = 0;
+        unsigned int n = 0;
+        unsigned int surfaces = 0;
+
+        void add(const RGB& c, const SurfaceFeature& f) {
+            float l = glm::dot(c, Vec3{ 0.2126f, 0.7152f, 0.0722f });
+            color += c;
+            luminance2 += l * l;
+            n++;
+            if (f.depth > 0) {
+                albedo += f.albedo;
+                normal += f.normal;
+                depth += f.depth;
+                surfaces++;
+            }
+        }
+    };
+
+    // 边缘保持的à-trous小波滤波(Dammertz 2010, 权重取自SVGF)
+    // 颜色先除以albedo得到辐照度, 滤波后再乘回去, 纹理和颜色边界不会被抹掉
+    // 每次迭代是一个5x5的B3样条核, 间隔依次为1, 2, 4, ...; 邻居的权重由亮度差(按方差归一化)、法线夹角和深度差决定
+    // 数据按通道分开存放, 每一行先循环核的偏移再循环像素, 最内层是连续访存且没有分支的循环, 便于编译器向量化
+    class Denoiser
+    {
+    private:
+        // 亮度、法线、深度权重的参数
+        constexpr static float sigmaLuminance = 4.f;
+        constexpr static float sigmaDepth = 1.f;
+        // 少于这么多次采样时像素自己的方差不可靠, 改用邻域内的方差
+        constexpr static unsigned int minTemporalSamples = 4;
+
+        unsigned int width;
+        unsigned int height;
+        unsigned int iterations;
+        TileScheduler scheduler;
+
+        struct Planes
+        {
+            vector<float> r, g, b, variance;
+            void resize(size_t n) {
+                r.assign(n, 0);
+                g.assign(n, 0);
+                b.assign(n, 0);
+                variance.assign(n, 0);
+            }
+        };
+        Planes planes[2];
+        vector<float> nx, ny, nz, depth, gradient, valid;
+        // 每次迭代前对方差做3x3高斯模糊, 单个像素的估计噪声太大
+        vector<float> smoothVariance;
+        vector<RGB> albedo;
+        double lastTime;
+
+        static float luminance(float r, float g, float b) {
+            return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+        }
+
+        // 深度在屏幕空间的变化率, 每个方向取两侧差值较小的一个, 物体边缘不会放大
+        void gradientTask(const Tile& tile) {
+            for (unsigned int y = tile.y0; y < tile.y1; y++) {
+                for (unsigned int x = tile.x0; x < tile.x1; x++) {
+                    size_t p = size_t(y) * width + x;
+                    if (valid[p] == 0) continue;
+                    auto slope = [&](int dx, int dy) {
+                        float best = FLT_MAX;
+                        for (int s = -1; s <= 1; s += 2) {
+                            int qx = int(x) + s * dx, qy = int(y) + s * dy;
+                            if (qx < 0 || qy < 0 || qx >= int(width) || qy >= int(height)) continue;
+                            size_t q = size_t(qy) * width + qx;
+                            if (valid[q] != 0) best = min(best, fabs(depth[q] - depth[p]));
+                        }
+                        return best == FLT_MAX ? 0.f : best;
+                    };
+                    gradient[p] = slope(1, 0) + slope(0, 1);
+                }
+            }
+        }
+
+        // 采样太少的像素用5x5邻域内同一表面的亮度方差代替
+        void spatialVarianceTask(const vector<DenoisePixel>& pixels, const Tile& tile) {
+            auto& in = planes[0];
+            for (unsigned int y = tile.y0; y < tile.y1; y++) {
+                for (unsigned int x = tile.x0; x < tile.x1; x++) {
+                    size_t p = size_t(y) * width + x;
+                    if (valid[p] == 0 || pixels[p].n >= minTemporalSamples) continue;
+                    float sum = 0, sum2 = 0, count = 0;
+                    for (int qy = max(0, int(y) - 2); qy <= min(int(height) - 1, int(y) + 2); qy++) {
+                        for (int qx = max(0, int(x) - 2); qx <= min(int(width) - 1, int(x) + 2); qx++) {
+                            size_t q = size_t(qy) * width + qx;
+                            if (valid[q] == 0) continue;
+                            if (nx[p] * nx[q] + ny[p] * ny[q] + nz[p] * nz[q] < 0.9f) continue;
+                            float l = luminance(in.r[q], in.g[q], in.b[q]);
+                            sum += l;
+                            sum2 += l * l;
+                            count++;
+                        }
+                    }
+                    float mean = sum / count;
+                    in.variance[p] = max(0.f, sum2 / count - mean * mean);
+                }
+            }
+        }
+
+        void smoothVarianceTask(const Planes& in, const Tile& tile) {
+            for (unsigned int y = tile.y0; y < tile.y1; y++) {
+                for (unsigned int x = tile.x0; x < tile.x1; x++) {
+                    float v = 0, w = 0;
+                    for (int qy = max(0, int(y) - 1); qy <= min(int(height) - 1, int(y) + 1); qy++) {
+                        for (int qx = max(0, int(x) - 1); qx <= min(int(width) - 1, int(x) + 1); qx++) {
+                            float k = (qx == int(x) ? 0.5f : 0.25f) * (qy == int(y) ? 0.5f : 0.25f);
+                            v += k * in.variance[size_t(qy) * width + qx];
+                            w += k;
+                        }
+                    }
+                    smoothVariance[size_t(y) * width + x] = v / w;
+                }
+            }
+        }
+
+        void filterTask(const Planes& in, Planes& out, unsigned int step, const Tile& tile) {
+            constexpr float kernel[3] = { 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+            const unsigned int tileWidth = tile.x1 - tile.x0;
+            vector<float> sumR(tileWidth), sumG(tileWidth), sumB(tileWidth), sumW(tileWidth), sumV(tileWidth);
+            vector<float> centerLuminance(tileWidth);
+            for (unsigned int y = tile.y0; y < tile.y1; y++) {
+                const size_t row = size_t(y) * width;
+                for (unsigned int c = 0; c < tileWidth; c++) {
+                    size_t p = row + tile.x0 + c;
+                    centerLuminance[c] = luminance(in.r[p], in.g[p], in.b[p]);
+                    sumR[c] = sumG[c] = sumB[c] = sumW[c] = sumV[c] = 0;
+                }
+                for (int dy = -2; dy <= 2; dy++) {
+                    int qy = int(y) + dy * int(step);
+                    if (qy < 0 || qy >= int(height)) continue;
+                    const size_t qRow = size_t(qy) * width;
+                    for (int dx = -2; dx <= 2; dx++) {
+                        const int offset = dx * int(step);
+                        const float h = kernel[abs(dx)] * kernel[abs(dy)];
+                        const float distance = float(step * (abs(dx) + abs(dy)));
+                        // 邻居落在图像外的像素不累加
+                        const int cBegin = max(0, -int(tile.x0) - offset);
+                        const int cEnd = min(int(tileWidth), int(width) - int(tile.x0) - offset);
+                        for (int c = cBegin; c < cEnd; c++) {
+                            const size_t p = row + tile.x0 + c;
+                            const size_t q = qRow + tile.x0 + c + offset;
+                            float cosine = max(0.f, nx[p] * nx[q] + ny[p] * ny[q] + nz[p] * nz[q]);
+                            // cos^128
+                            for (int s = 0; s < 7; s++) cosine *= cosine;
+                            // 用两个像素方差的几何平均归一化, 权重对称
+                            // 只用中心像素的方差时, 偶然偏亮的像素方差也大, 会被邻居拉暗, 整幅图偏暗; 用方差之和时方差极大的像素会扩散到邻居
+                            float dl = fabs(luminance(in.r[q], in.g[q], in.b[q]) - centerLuminance[c])
+                                / (sigmaLuminance * sqrt(sqrt(smoothVariance[p] * smoothVariance[q])) + 1e-4f);
+                            float dz = fabs(depth[q] - depth[p]) / (sigmaDepth * gradient[p] * distance + 1e-3f * depth[p] + 1e-6f);
+                            float w = h * valid[q] * cosine * exp(-dl - dz);
+                            sumR[c] += w * in.r[q];
+                            sumG[c] += w * in.g[q];
+                            sumB[c] += w * in.b[q];
+                            sumW[c] += w;
+                            sumV[c] += w * w * in.variance[q];
+                        }
+                    }
+                }
+                for (unsigned int c = 0; c < tileWidth; c++) {
+                    size_t p = row + tile.x0 + c;
+                    // 中心像素自己的权重为h>0, 有效像素的sumW不会为0
+                    if (valid[p] == 0 || sumW[c] <= 0) {
+                        out.r[p] = in.r[p];
+                        out.g[p] = in.g[p];
+                        out.b[p] = in.b[p];
+                        out.variance[p] = in.variance[p];
+                        continue;
+                    }
+                    out.r[p] = sumR[c] / sumW[c];
+                    out.g[p] = sumG[c] / sumW[c];
+                    out.b[p] = sumB[c] / sumW[c];
+                    out.variance[p] = sumV[c] / (sumW[c] * sumW[c]);
+                }
+            }
+        }
+    public:
+        // threads为0时使用hardware_concurrency
+        Denoiser(unsigned int width, unsigned int height, unsigned int iterations = 5, unsigned int threads = 0)
+            : width             (width)
+            , height            (height)
+            , iterations        (iterations)
+            , scheduler         (width, height, 32, threads)
+            , lastTime          (0)
+        {}
+
+        // pixels按行存储, 返回每个像素滤波后的线性颜色(采样的平均)
+        vector<RGB> run(const vector<DenoisePixel>& pixels) {
+            auto start = chrono::steady_clock::now();
+            const size_t n = size_t(width) * height;
+            planes[0].resize(n);
+            planes[1].resize(n);
+            nx.assign(n, 0);
+            ny.assign(n, 0);
+            nz.assign(n, 0);
+            depth.assign(n, 0);
+            gradient.assign(n, 0);
+            valid.assign(n, 0);
+            smoothVariance.assign(n, 0);
+            albedo.assign(n, RGB{ 1 });
+            auto& in = planes[0];
+            for (size_t p = 0; p < n; p++) {
+                auto& px = pixels[p];
+                if (px.n == 0) continue;
+                RGB mean = px.color / float(px.n);
+                // 只有所有采样都打到表面时才滤波, 光源和物体的边缘保持原样
+                bool surface = px.surfaces == px.n;
+                RGB a = surface ? glm::max(px.albedo / float(px.surfaces), RGB{ 1e-3f }) : RGB{ 1 };
+                RGB irradiance = mean / a;
+                in.r[p] = irradiance.r;
+                in.g[p] = irradiance.g;
+                in.b[p] = irradiance.b;
+                // 均值的方差 = 样本方差 / n, 除以albedo亮度的平方换算到辐照度
+                float l = luminance(mean.r, mean.g, mean.b);
+                float sampleVariance = max(0.f, px.luminance2 / float(px.n) - l * l);
+                float al = luminance(a.r, a.g, a.b);
+                in.variance[p] = sampleVariance / float(px.n) / (al * al);
+                albedo[p] = a;
+                if (!surface) continue;
+                Vec3 normal = px.normal / float(px.surfaces);
+                float length = glm::length(normal);
+                if (length <= 0) continue;
+                normal /= length;
+                nx[p] = normal.x;
+                ny[p] = normal.y;
+                nz[p] = normal.z;
+                depth[p] = px.depth / float(px.surfaces);
+                valid[p] = 1;
+            }
+            scheduler.run([&](const Tile& tile, unsigned int) {
+                gradientTask(tile);
+                spatialVarianceTask(pixels, tile);
+            });
+            unsigned int current = 0;
+            for (unsigned int i = 0; i < iterations; i++) {
+                scheduler.run([&](const Tile& tile, unsigned int) {
+                    smoothVarianceTask(planes[current], tile);
+                });
+                scheduler.run([&, i](const Tile& tile, unsigned int) {
+                    filterTask(planes[current], planes[1 - current], 1u << i, tile);
+                });
+                current = 1 - current;
+            }
+            vector<RGB> result(n);
+            auto& out = planes[current];
+            for (size_t p = 0; p < n; p++) {
+                result[p] = RGB{ out.r[p], out.g[p], out.b[p] } * albedo[p];
+            }
+            lastTime = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        // 最近一次run的耗时
+        double milliseconds() const {
+            return lastTime;
+        }
+    };
+}
+
+#endif
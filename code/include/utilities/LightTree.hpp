@@ -0,0 +1,356 @@
+#pragma once
+#ifndef __NR_LIGHT_TREE_HPP__
+#define __NR_LIGHT_TREE_HPP__
+
+#include "geometry/vec.hpp"
+#include "scene/Light.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <numbers>
+#include <algorithm>
+
+namespace NRenderer
+{
+    using namespace std;
+
+    // 一组光源的包围信息: 包围盒, 法线的方向锥, 功率
+    struct LightBounds
+    {
+        Vec3 boundMin{ FLT_MAX };
+        Vec3 boundMax{ -FLT_MAX };
+        // 所有法线都在以axis为轴、半角为acos(cosNormal)的锥内
+        Vec3 axis{ 0, 0, 1 };
+        float cosNormal = 1;
+        // 发射方向与法线的最大夹角, 面光源为90度
+        float cosEmission = 0;
+        float power = 0;
+        bool twoSided = false;
+
+        Vec3 center() const { return (boundMin + boundMax) * 0.5f; }
+    };
+
+    // 光源层次结构(light BVH, Conty & Kulla 2018, 按pbrt-v4的实现)
+    // 按包围盒、方向锥和功率聚类, 着色点从根向下按子节点的重要性选择, 采样和求pmf都是 O(log n)
+    // 同一棵树也用来求光线与光源的最近交点
+    class LightTree
+    {
+    private:
+        struct Node
+        {
+            LightBounds bounds;
+            // 内部节点: 第二个子节点的下标, 第一个子节点紧跟在后面; 叶子: 光源下标
+            unsigned int index;
+            bool leaf;
+        };
+        vector<Node> nodes;
+        // 每个光源从根到叶子的路径, 第k位是第k层走向哪个子节点
+        vector<uint64_t> bitTrails;
+        // 不发光的光源不参与采样, 但仍然可以被光线打到, 求交时逐个测试
+        vector<Node> dark;
+
+        static float safeSqrt(float x) { return sqrt(max(0.f, x)); }
+
+        // cos(max(0, a - b))
+        static float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+            if (cosA > cosB) return 1;
+            return cosA * cosB + sinA * sinB;
+        }
+
+        // sin(max(0, a - b))
+        static float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+            if (cosA > cosB) return 0;
+            return sinA * cosB - cosA * sinB;
+        }
+
+        // 两个方向锥的并
+        static void unionCone(const Vec3& a, float cosA, const Vec3& b, float cosB, Vec3& axis, float& cosTheta) {
+            const float pi = numbers::pi_v<float>;
+            float thetaA = acos(glm::clamp(cosA, -1.f, 1.f));
+            float thetaB = acos(glm::clamp(cosB, -1.f, 1.f));
+            float thetaD = acos(glm::clamp(glm::dot(a, b), -1.f, 1.f));
+            if (min(thetaD + thetaB, pi) <= thetaA) {
+                axis = a;
+                cosTheta = cosA;
+                return;
+            }
+            if (min(thetaD + thetaA, pi) <= thetaB) {
+                axis = b;
+                cosTheta = cosB;
+                return;
+            }
+            float thetaO = (thetaA + thetaD + thetaB) / 2;
+            Vec3 k = glm::cross(a, b);
+            float l = glm::length(k);
+            if (thetaO >= pi || l == 0) {
+                axis = a;
+                cosTheta = -1;
+                return;
+            }
+            // 把a绕k向b旋转thetaO - thetaA
+            float thetaR = thetaO - thetaA;
+            k /= l;
+            axis = glm::normalize(a * cos(thetaR) + glm::cross(k, a) * sin(thetaR));
+            cosTheta = cos(thetaO);
+        }
+
+        static LightBounds unionBounds(const LightBounds& a, const LightBounds& b) {
+            if (a.power == 0) return b;
+            if (b.power == 0) return a;
+            LightBounds r;
+            r.boundMin = glm::min(a.boundMin, b.boundMin);
+            r.boundMax = glm::max(a.boundMax, b.boundMax);
+            unionCone(a.axis, a.cosNormal, b.axis, b.cosNormal, r.axis, r.cosNormal);
+            r.cosEmission = min(a.cosEmission, b.cosEmission);
+            r.power = a.power + b.power;
+            r.twoSided = a.twoSided || b.twoSided;
+            return r;
+        }
+
+        // 划分的代价: 功率 * 方向锥覆盖的立体角 * 包围盒表面积, 细长的包围盒在短边方向上的划分加大代价
+        static float splitCost(const LightBounds& b, const Vec3& extent, int dim) {
+            const float pi = numbers::pi_v<float>;
+            float thetaO = acos(glm::clamp(b.cosNormal, -1.f, 1.f));
+            float thetaE = acos(glm::clamp(b.cosEmission, -1.f, 1.f));
+            float thetaW = min(thetaO + thetaE, pi);
+            float sinO = safeSqrt(1 - b.cosNormal * b.cosNormal);
+            float solidAngle = 2 * pi * (1 - b.cosNormal)
+                + pi / 2 * (2 * thetaW * sinO - cos(thetaO - 2 * thetaW) - 2 * thetaO * sinO + b.cosNormal);
+            float kr = extent[dim] > 0 ? max(extent.x, max(extent.y, extent.z)) / extent[dim] : 1.f;
+            Vec3 d = b.boundMax - b.boundMin;
+            float area = 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+            return b.power * solidAngle * kr * area;
+        }
+
+        // 返回节点下标
+        unsigned int build(vector<LightBounds>& lights, vector<unsigned int>& order, size_t start, size_t end, uint64_t trail, int depth) {
+            if (end - start == 1) {
+                unsigned int light = order[start];
+                nodes.push_back({ lights[light], light, true });
+                bitTrails[light] = trail;
+                return unsigned(nodes.size() - 1);
+            }
+            // 按光源中心分桶, 在三个轴上找代价最小的划分
+            Vec3 centerMin{ FLT_MAX }, centerMax{ -FLT_MAX };
+            LightBounds all;
+            for (size_t i = start; i < end; i++) {
+                auto& b = lights[order[i]];
+                centerMin = glm::min(centerMin, b.center());
+                centerMax = glm::max(centerMax, b.center());
+                all = unionBounds(all, b);
+            }
+            Vec3 extent = all.boundMax - all.boundMin;
+            constexpr int bucketNums = 12;
+            float bestCost = FLT_MAX;
+            int bestDim = -1, bestBucket = -1;
+            for (int dim = 0; dim < 3; dim++) {
+                if (centerMax[dim] == centerMin[dim]) continue;
+                LightBounds buckets[bucketNums];
+                auto bucketOf = [&](const LightBounds& b) {
+                    int k = int(bucketNums * (b.center()[dim] - centerMin[dim]) / (centerMax[dim] - centerMin[dim]));
+                    return glm::clamp(k, 0, bucketNums - 1);
+                };
+                for (size_t i = start; i < end; i++) {
+                    auto& b = lights[order[i]];
+                    auto& bucket = buckets[bucketOf(b)];
+                    bucket = unionBounds(bucket, b);
+                }
+                for (int k = 0; k < bucketNums - 1; k++) {
+                    LightBounds below, above;
+                    for (int s = 0; s <= k; s++) below = unionBounds(below, buckets[s]);
+                    for (int s = k + 1; s < bucketNums; s++) above = unionBounds(above, buckets[s]);
+                    float cost = splitCost(below, extent, dim) + splitCost(above, extent, dim);
+                    if (cost > 0 && cost < bestCost) {
+                        bestCost = cost;
+                        bestDim = dim;
+                        bestBucket = k;
+                    }
+                }
+            }
+            size_t mid = (start + end) / 2;
+            if (bestDim >= 0) {
+                auto it = partition(order.begin() + start, order.begin() + end, [&](unsigned int light) {
+                    auto& b = lights[light];
+                    int k = int(bucketNums * (b.center()[bestDim] - centerMin[bestDim]) / (centerMax[bestDim] - centerMin[bestDim]));
+                    return glm::clamp(k, 0, bucketNums - 1) <= bestBucket;
+                });
+                size_t m = size_t(it - order.begin());
+                if (m != start && m != end) mid = m;
+            }
+            // 路径用64位保存, 层数过多时退化为对半分
+            if (depth >= 40) mid = (start + end) / 2;
+
+            unsigned int node = unsigned(nodes.size());
+            nodes.push_back({ all, 0, false });
+            build(lights, order, start, mid, trail, depth + 1);
+            unsigned int second = build(lights, order, mid, end, trail | (uint64_t(1) << depth), depth + 1);
+            nodes[node].index = second;
+            return node;
+        }
+
+        // 着色点(p, n)处一组光源贡献的上界的估计, n为0时不考虑着色点的朝向
+        float importance(const LightBounds& b, const Vec3& p, const Vec3& n) const {
+            Vec3 pc = b.center();
+            Vec3 diagonal = b.boundMax - b.boundMin;
+            float d2 = glm::dot(p - pc, p - pc);
+            d2 = max(d2, glm::length(diagonal) / 2);
+            if (d2 <= 0) return 0;
+            Vec3 wi = (p - pc) / sqrt(glm::dot(p - pc, p - pc) + 1e-20f);
+            float cosW = glm::dot(b.axis, wi);
+            if (b.twoSided) cosW = fabs(cosW);
+            float sinW = safeSqrt(1 - cosW * cosW);
+            // 包围盒的外接球从p看过去的半角
+            float radius2 = glm::dot(diagonal, diagonal) / 4;
+            float cosB = -1;
+            if (glm::dot(p - pc, p - pc) > radius2) {
+                cosB = safeSqrt(1 - radius2 / glm::dot(p - pc, p - pc));
+            }
+            float sinB = safeSqrt(1 - cosB * cosB);
+            float sinO = safeSqrt(1 - b.cosNormal * b.cosNormal);
+            float cosX = cosSubClamped(sinW, cosW, sinO, b.cosNormal);
+            float sinX = sinSubClamped(sinW, cosW, sinO, b.cosNormal);
+            float cosP = cosSubClamped(sinX, cosX, sinB, cosB);
+            if (cosP <= b.cosEmission) return 0;
+            float result = b.power * cosP / d2;
+            if (n != Vec3{ 0 }) {
+                float cosI = fabs(glm::dot(wi, n));
+                float sinI = safeSqrt(1 - cosI * cosI);
+                result *= cosSubClamped(sinI, cosI, sinB, cosB);
+            }
+            return max(result, 0.f);
+        }
+
+        static bool hitBox(const LightBounds& b, const Vec3& origin, const Vec3& invDirection, float tMax) {
+            float t0 = 0, t1 = tMax;
+            for (int dim = 0; dim < 3; dim++) {
+                float near = (b.boundMin[dim] - origin[dim]) * invDirection[dim];
+                float far = (b.boundMax[dim] - origin[dim]) * invDirection[dim];
+                if (near > far) swap(near, far);
+                // 方向分量为0且起点在边界上时为NaN, 此时不裁剪
+                if (near == near) t0 = max(t0, near);
+                if (far == far) t1 = min(t1, far);
+                if (t0 > t1) return false;
+            }
+            return true;
+        }
+
+    public:
+        LightTree() = default;
+
+        // twoSided: 光源两面都发光; 否则只向 u x v 一侧发光
+        void build(const vector<AreaLight>& areaLights, bool twoSided) {
+            nodes.clear();
+            dark.clear();
+            bitTrails.assign(areaLights.size(), 0);
+            vector<LightBounds> lights;
+            vector<unsigned int> order;
+            for (unsigned int i = 0; i < areaLights.size(); i++) {
+                auto& a = areaLights[i];
+                Vec3 normal = glm::cross(a.u, a.v);
+                float area = glm::length(normal);
+                LightBounds b;
+                Vec3 corners[4] = { a.position, a.position + a.u, a.position + a.v, a.position + a.u + a.v };
+                for (auto& c : corners) {
+                    b.boundMin = glm::min(b.boundMin, c);
+                    b.boundMax = glm::max(b.boundMax, c);
+                }
+                // 平面光源的包围盒有一个方向厚度为0, 稍微放大, 避免光线求交时的退化
+                Vec3 pad = 1e-4f * (b.boundMax - b.boundMin) + 1e-4f * glm::max(glm::abs(b.boundMin), glm::abs(b.boundMax)) + 1e-6f;
+                b.boundMin -= pad;
+                b.boundMax += pad;
+                b.axis = area > 0 ? normal / area : Vec3{ 0, 0, 1 };
+                b.cosNormal = 1;
+                b.cosEmission = 0;
+                b.power = glm::dot(a.radiance, Vec3{ 0.2126f, 0.7152f, 0.0722f }) * area * (twoSided ? 2.f : 1.f);
+                b.twoSided = twoSided;
+                lights.push_back(b);
+                if (b.power > 0) order.push_back(i);
+            }
+            nodes.reserve(2 * order.size());
+            if (!order.empty()) build(lights, order, 0, order.size(), 0, 0);
+            for (unsigned int i = 0; i < lights.size(); i++) {
+                if (lights[i].power <= 0) dark.push_back({ lights[i], i, true });
+            }
+        }
+
+        bool empty() const { return nodes.empty(); }
+
+        // 在着色点(p, n)按重要性选一个光源, 返回 { 光源下标, 概率 }, 没有可选的光源时下标为-1
+        pair<int, float> sample(const Vec3& p, const Vec3& n, float u) const {
+            if (nodes.empty()) return { -1, 0.f };
+            unsigned int node = 0;
+            float pmf = 1;
+            while (!nodes[node].leaf) {
+                float c0 = importance(nodes[node + 1].bounds, p, n);
+                float c1 = importance(nodes[nodes[node].index].bounds, p, n);
+                if (c0 + c1 <= 0) return { -1, 0.f };
+                float p0 = c0 / (c0 + c1);
+                if (u < p0) {
+                    u = min(u / p0, 0x1.fffffep-1f);
+                    pmf *= p0;
+                    node = node + 1;
+                }
+                else {
+                    u = min((u - p0) / (1 - p0), 0x1.fffffep-1f);
+                    pmf *= 1 - p0;
+                    node = nodes[node].index;
+                }
+            }
+            if (importance(nodes[node].bounds, p, n) <= 0) return { -1, 0.f };
+            return { int(nodes[node].index), pmf };
+        }
+
+        // sample在(p, n)处选到light的概率
+        float pmf(const Vec3& p, const Vec3& n, unsigned int light) const {
+            if (nodes.empty() || light >= bitTrails.size()) return 0;
+            uint64_t trail = bitTrails[light];
+            unsigned int node = 0;
+            float pmf = 1;
+            while (!nodes[node].leaf) {
+                float c0 = importance(nodes[node + 1].bounds, p, n);
+                float c1 = importance(nodes[nodes[node].index].bounds, p, n);
+                if (c0 + c1 <= 0) return 0;
+                if (trail & 1) {
+                    pmf *= c1 / (c0 + c1);
+                    node = nodes[node].index;
+                }
+                else {
+                    pmf *= c0 / (c0 + c1);
+                    node = node + 1;
+                }
+                trail >>= 1;
+            }
+            if (nodes[node].index != light || importance(nodes[node].bounds, p, n) <= 0) return 0;
+            return pmf;
+        }
+
+        // 遍历包围盒与光线相交的叶子, hit(光源下标, tMax)求交并返回新的tMax
+        template <typename F>
+        void intersect(const Vec3& origin, const Vec3& direction, float tMax, F&& hit) const {
+            Vec3 invDirection = 1.f / direction;
+            for (auto& d : dark) {
+                if (hitBox(d.bounds, origin, invDirection, tMax)) tMax = hit(d.index, tMax);
+            }
+            if (nodes.empty()) return;
+            unsigned int stack[128];
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                auto& node = nodes[stack[--top]];
+                if (!hitBox(node.bounds, origin, invDirection, tMax)) continue;
+                if (node.leaf) {
+                    tMax = hit(node.index, tMax);
+                    continue;
+                }
+                stack[top++] = node.index;
+                stack[top++] = unsigned(&node - nodes.data()) + 1;
+            }
+        }
+
+        size_t size() const { return nodes.size(); }
+    };
+}
+
+#endif
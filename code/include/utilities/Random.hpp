@@ -0,0 +1,75 @@
+#pragma once
+#ifndef __NR_RANDOM_HPP__
+#define __NR_RANDOM_HPP__
+
+#include <cstdint>
+#include <algorithm>
+
+#include "geometry/vec.hpp"
+
+namespace NRenderer
+{
+    // 64位混合函数(SplitMix64的finalizer)
+    inline uint64_t mixBits(uint64_t v) {
+        v ^= v >> 31;
+        v *= 0x7fb5d329728ea185ull;
+        v ^= v >> 27;
+        v *= 0x81dadef4bc2dd44dull;
+        v ^= v >> 33;
+        return v;
+    }
+
+    inline uint64_t hashValues(uint64_t a, uint64_t b) {
+        return mixBits(a * 0x9e3779b97f4a7c15ull + mixBits(b));
+    }
+
+    inline uint64_t hashValues(uint64_t a, uint64_t b, uint64_t c) {
+        return hashValues(hashValues(a, b), c);
+    }
+
+    // 小于1的最大float
+    constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+    // 高24位转成[0, 1)
+    inline float toUnitFloat(uint32_t v) {
+        return std::min(float(v >> 8) * 0x1p-24f, ONE_MINUS_EPSILON);
+    }
+
+    // PCG32(O'Neill 2014): 64位状态, 每次输出32位
+    // 按 (像素, 第几次采样) 或光子下标等构造, 结果与线程数和调度顺序无关; 对象很小, 放在栈上使用
+    class Pcg32
+    {
+    private:
+        uint64_t state;
+        uint64_t inc;
+    public:
+        explicit Pcg32(uint64_t seed, uint64_t stream = 0)
+            : state         (0)
+            , inc           ((stream << 1) | 1)
+        {
+            nextUInt();
+            state += mixBits(seed);
+            nextUInt();
+        }
+
+        uint32_t nextUInt() {
+            uint64_t old = state;
+            state = old * 6364136223846793005ull + inc;
+            uint32_t xorShifted = uint32_t(((old >> 18) ^ old) >> 27);
+            uint32_t rot = uint32_t(old >> 59);
+            return (xorShifted >> rot) | (xorShifted << ((~rot + 1) & 31));
+        }
+
+        // 返回[0, 1)
+        float nextFloat() {
+            return toUnitFloat(nextUInt());
+        }
+
+        Vec2 next2d() {
+            float x = nextFloat();
+            return { x, nextFloat() };
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,191 @@
+#pragma once
+#ifndef __NR_TILE_SCHEDULER_HPP__
+#define __NR_TILE_SCHEDULER_HPP__
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+namespace NRenderer
+{
+    using namespace std;
+
+    // 图像上的一块, 行[y0, y1), 列[x0, x1); 行号和渲染器的i一致, 从0开始
+    struct Tile
+    {
+        unsigned int index;
+        unsigned int x0, y0;
+        unsigned int x1, y1;
+    };
+
+    // 分块渲染的调度器, 各组件共用
+    // 所有块按Hilbert曲线排序, 按顺序平均分成连续的几段放进每个线程的双端队列
+    // 线程从自己队列的头部取块, 队列空了以后从其他线程队列的尾部偷取
+    class TileScheduler
+    {
+    public:
+        struct ThreadStats
+        {
+            double busy = 0;
+            double idle = 0;
+            size_t tiles = 0;
+            size_t steals = 0;
+        };
+    private:
+        struct Queue
+        {
+            mutex mtx;
+            deque<unsigned int> tiles;
+        };
+        vector<Tile> tiles;
+        unsigned int threadNums;
+        vector<ThreadStats> threadStats;
+        double wallTime;
+
+        // Hilbert曲线上第d个点的坐标, n为2的幂
+        static void hilbert(unsigned int n, unsigned int d, unsigned int& x, unsigned int& y) {
+            x = y = 0;
+            for (unsigned int s = 1; s < n; s *= 2) {
+                unsigned int rx = 1 & (d / 2);
+                unsigned int ry = 1 & (d ^ rx);
+                if (ry == 0) {
+                    if (rx == 1) {
+                        x = s - 1 - x;
+                        y = s - 1 - y;
+                    }
+                    swap(x, y);
+                }
+                x += s * rx;
+                y += s * ry;
+                d /= 4;
+            }
+        }
+
+        bool pop(vector<unique_ptr<Queue>>& queues, unsigned int self, unsigned int& tile, bool& stolen) {
+            {
+                lock_guard lock{ queues[self]->mtx };
+                if (!queues[self]->tiles.empty()) {
+                    tile = queues[self]->tiles.front();
+                    queues[self]->tiles.pop_front();
+                    stolen = false;
+                    return true;
+                }
+            }
+            // 从剩余最多的线程尾部偷取, 尾部离该线程正在渲染的区域最远
+            while (true) {
+                unsigned int victim = self;
+                size_t most = 0;
+                for (unsigned int t = 0; t < threadNums; t++) {
+                    if (t == self) continue;
+                    lock_guard lock{ queues[t]->mtx };
+                    if (queues[t]->tiles.size() > most) {
+                        most = queues[t]->tiles.size();
+                        victim = t;
+                    }
+                }
+                if (victim == self) return false;
+                lock_guard lock{ queues[victim]->mtx };
+                if (queues[victim]->tiles.empty()) continue;
+                tile = queues[victim]->tiles.back();
+                queues[victim]->tiles.pop_back();
+                stolen = true;
+                return true;
+            }
+        }
+    public:
+        // threads为0时使用hardware_concurrency
+        TileScheduler(unsigned int width, unsigned int height, unsigned int tileSize = 16, unsigned int threads = 0)
+            : tiles             ()
+            , threadNums        (threads > 0 ? threads : max(1u, thread::hardware_concurrency()))
+            , threadStats       ()
+            , wallTime          (0)
+        {
+            tileSize = max(1u, tileSize);
+            unsigned int tilesX = (width + tileSize - 1) / tileSize;
+            unsigned int tilesY = (height + tileSize - 1) / tileSize;
+            unsigned int n = 1;
+            while (n < tilesX || n < tilesY) n *= 2;
+            for (unsigned int d = 0; d < n * n; d++) {
+                unsigned int x, y;
+                hilbert(n, d, x, y);
+                if (x >= tilesX || y >= tilesY) continue;
+                tiles.push_back({
+                    unsigned(tiles.size()),
+                    x * tileSize, y * tileSize,
+                    min(width, (x + 1) * tileSize), min(height, (y + 1) * tileSize)
+                });
+            }
+        }
+
+        unsigned int size() const {
+            return unsigned(tiles.size());
+        }
+
+        unsigned int threads() const {
+            return threadNums;
+        }
+
+        // f(const Tile&, unsigned int threadIndex), 阻塞直到所有块完成
+        template<typename F>
+        void run(F&& f) {
+            vector<unique_ptr<Queue>> queues;
+            for (unsigned int t = 0; t < threadNums; t++) {
+                queues.push_back(make_unique<Queue>());
+                size_t begin = tiles.size() * t / threadNums;
+                size_t end = tiles.size() * (t + 1) / threadNums;
+                for (size_t i = begin; i < end; i++) queues[t]->tiles.push_back(unsigned(i));
+            }
+            threadStats.assign(threadNums, {});
+            auto start = chrono::steady_clock::now();
+            auto worker = [&](unsigned int self) {
+                auto& stats = threadStats[self];
+                unsigned int tile;
+                bool stolen;
+                while (pop(queues, self, tile, stolen)) {
+                    auto begin = chrono::steady_clock::now();
+                    f(tiles[tile], self);
+                    stats.busy += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+                    stats.tiles++;
+                    if (stolen) stats.steals++;
+                }
+                stats.idle = chrono::duration<double>(chrono::steady_clock::now() - start).count() - stats.busy;
+            };
+            vector<thread> workers;
+            for (unsigned int t = 1; t < threadNums; t++) {
+                workers.emplace_back(worker, t);
+            }
+            worker(0);
+            for (auto& w : workers) w.join();
+            wallTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            // 先结束的线程等待其他线程的时间也算空闲
+            for (auto& s : threadStats) s.idle = wallTime - s.busy;
+        }
+
+        const vector<ThreadStats>& stats() const {
+            return threadStats;
+        }
+
+        // 最近一次run的汇总, 用于日志
+        string report() const {
+            double busy = 0, minBusy = wallTime, maxBusy = 0;
+            size_t steals = 0;
+            for (auto& s : threadStats) {
+                busy += s.busy;
+                minBusy = min(minBusy, s.busy);
+                maxBusy = max(maxBusy, s.busy);
+                steals += s.steals;
+            }
+            double utilization = wallTime > 0 ? busy / (wallTime * threadNums) : 0;
+            return to_string(tiles.size()) + " tiles on " + to_string(threadNums) + " threads, "
+                + to_string(wallTime * 1000) + "ms, busy " + to_string(utilization * 100) + "%, per-thread busy "
+                + to_string(minBusy * 1000) + "~" + to_string(maxBusy * 1000) + "ms, " + to_string(steals) + " steals";
+        }
+    };
+}
+
+#endif
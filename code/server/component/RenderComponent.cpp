@@ -1,8 +1,10 @@
 #include "component/RenderComponent.hpp"
+#include "server/Server.hpp"
 
 namespace NRenderer
 {
     void RenderComponent::exec(function<void()> onStart, function<void()> onFinish, SharedScene spScene) {
+        getServer().control.reset();
         onStart();
         render(spScene);
         onFinish();
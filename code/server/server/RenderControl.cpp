@@ -0,0 +1,25 @@
+#include "server/RenderControl.hpp"
+
+namespace NRenderer
+{
+    RenderControl::RenderControl()
+        : stop              (false)
+        , stoppable         (false)
+    {}
+    void RenderControl::requestStop() {
+        stop = true;
+    }
+    void RenderControl::reset() {
+        stop = false;
+        stoppable = false;
+    }
+    bool RenderControl::stopRequested() const {
+        return stop;
+    }
+    void RenderControl::setStoppable(bool value) {
+        stoppable = value;
+    }
+    bool RenderControl::isStoppable() const {
+        return stoppable;
+    }
+} // namespace NRenderer
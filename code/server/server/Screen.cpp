@@ -1,14 +1,43 @@
 #include "Server/Screen.hpp"
 
 #include <cstdlib>
+#include <algorithm>
 
 namespace NRenderer
 {
+    namespace
+    {
+        // 把通道的原始数值映射成可显示的颜色, 标量通道除以全图最大值
+        RGBA displayColor(Channel c, const RGBA& v, float maxValue) {
+            switch (c)
+            {
+            case Channel::NORMAL:
+                return { Vec3{ v } * 0.5f + 0.5f, 1 };
+            case Channel::MATERIAL_ID: {
+                if (v.r < 0) return { 0, 0, 0, 1 };
+                // 相邻的材质下标映射到差别较大的颜色
+                unsigned int h = (unsigned int)(v.r + 1) * 2654435761u;
+                return { float(h & 0xff) / 255.f, float((h >> 8) & 0xff) / 255.f, float((h >> 16) & 0xff) / 255.f, 1 };
+            }
+            case Channel::DEPTH:
+            case Channel::SAMPLE_COUNT:
+            case Channel::RENDER_TIME: {
+                float x = maxValue > 0 ? v.r / maxValue : 0.f;
+                return { x, x, x, 1 };
+            }
+            default:
+                return clamp(v);
+            }
+        }
+    }
+
     Screen::Screen()
         : width             (500)
         , height            (500)
         , updated           (false)
         , mtx               ()
+        , frame             (500, 500, channelBit(Channel::COLOR))
+        , selected          (Channel::COLOR)
     {
         pixels = new RGBA[height * width];
         for (int i=0; i<height; i++) {
@@ -31,6 +60,7 @@ namespace NRenderer
         }
         delete[] pixels;
         pixels = nullptr;
+        frame = FrameBuffer{};
         mtx.unlock();
     }
     unsigned int Screen::getWidth() const {
@@ -59,9 +89,63 @@ namespace NRenderer
         if (this->pixels!=nullptr)
             delete[] this->pixels;
         this->pixels = new RGBA[width*height];
+        frame = FrameBuffer{ (unsigned int)width, (unsigned int)height, channelBit(Channel::COLOR) };
+        auto color = frame.data(Channel::COLOR);
         for (int i=0; i<width*height; i++) {
-            this->pixels[i] = clamp(pixels[i]);
+            color[i] = clamp(pixels[i]);
         }
+        updateDisplay();
         mtx.unlock();
     }
+    void Screen::setChannels(const FrameBuffer& aovs) {
+        mtx.lock();
+        if (pixels != nullptr) {
+            frame.merge(aovs);
+            updateDisplay();
+            updated = true;
+        }
+        mtx.unlock();
+    }
+    void Screen::select(Channel c) {
+        mtx.lock();
+        selected = c;
+        if (pixels != nullptr) {
+            updateDisplay();
+            updated = true;
+        }
+        mtx.unlock();
+    }
+    Channel Screen::getSelected() const {
+        mtx.lock();
+        auto c = selected;
+        mtx.unlock();
+        return c;
+    }
+    unsigned int Screen::getChannelMask() const {
+        mtx.lock();
+        auto m = frame.getMask();
+        mtx.unlock();
+        return m;
+    }
+    vector<RGBA> Screen::getChannel(Channel c) const {
+        mtx.lock();
+        vector<RGBA> values;
+        if (auto p = frame.data(c)) values.assign(p, p + size_t(width)*height);
+        mtx.unlock();
+        return values;
+    }
+    // 调用时已持有锁
+    void Screen::updateDisplay() {
+        auto c = frame.has(selected) ? selected : Channel::COLOR;
+        auto src = frame.data(c);
+        if (src == nullptr) return;
+        size_t n = size_t(width)*height;
+        float maxValue = 0;
+        for (size_t i=0; i<n; i++) {
+            maxValue = std::max(maxValue, src[i].r);
+        }
+        for (size_t i=0; i<n; i++) {
+            pixels[i] = displayColor(c, src[i], maxValue);
+        }
+    }
 } // namespace NRenderer
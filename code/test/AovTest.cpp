@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+#include "utilities/Aov.hpp"
+
+using namespace NRenderer;
+
+TEST(AovTest, DispatchPassesMaskAsTemplateArgument) {
+    for (unsigned int mask : { 0u, channelBit(Channel::DEPTH), AOV_CHANNELS, channelBit(Channel::NORMAL) | channelBit(Channel::RENDER_TIME) }) {
+        unsigned int seen = ~0u;
+        dispatchAovs(mask, [&]<unsigned int Channels>() { seen = Channels; });
+        EXPECT_EQ(seen, mask);
+    }
+    // 颜色不是附加通道, 不参与分派
+    unsigned int seen = ~0u;
+    dispatchAovs(channelBit(Channel::COLOR) | channelBit(Channel::ALBEDO), [&]<unsigned int Channels>() { seen = Channels; });
+    EXPECT_EQ(seen, channelBit(Channel::ALBEDO));
+}
+
+TEST(AovTest, OnlyRequestedChannelsAccumulate) {
+    constexpr unsigned int channels = channelBit(Channel::DEPTH) | channelBit(Channel::SAMPLE_COUNT);
+    AovPixel pixel{};
+    pixel.add<channels>(SurfaceFeature{ RGB{ 0.5f }, Vec3{ 0, 1, 0 }, 2.f, 3 });
+    pixel.add<channels>(SurfaceFeature{ RGB{ 0.5f }, Vec3{ 0, 1, 0 }, 4.f, 1 });
+    // 没有打到表面的采样只计数
+    pixel.add<channels>(SurfaceFeature{});
+    EXPECT_EQ(pixel.samples, 3u);
+    EXPECT_EQ(pixel.surfaces, 2u);
+    EXPECT_FLOAT_EQ(pixel.depth, 6.f);
+    EXPECT_TRUE(pixel.normal == Vec3{ 0 });
+    EXPECT_TRUE(pixel.albedo == RGB{ 0 });
+    EXPECT_EQ(pixel.material, -1);
+}
+
+TEST(AovTest, WritesAveragesWithColorRowOrder) {
+    constexpr unsigned int channels = channelBit(Channel::DEPTH) | channelBit(Channel::NORMAL) | channelBit(Channel::MATERIAL_ID);
+    const unsigned int width = 3, height = 2;
+    vector<AovPixel> pixels(width * height);
+    pixels[0 * width + 1].add<channels>(SurfaceFeature{ RGB{ 1 }, Vec3{ 0, 0, 1 }, 1.f, 7 });
+    pixels[0 * width + 1].add<channels>(SurfaceFeature{ RGB{ 1 }, Vec3{ 0, 0, 1 }, 3.f, 2 });
+
+    FrameBuffer frame{ width, height, channels };
+    writeAovs<channels>(frame, pixels);
+    EXPECT_FALSE(frame.has(Channel::ALBEDO));
+    EXPECT_EQ(frame.data(Channel::ALBEDO), nullptr);
+    // 第0行写到最后一行
+    size_t p = (height - 1) * width + 1;
+    EXPECT_FLOAT_EQ(frame.data(Channel::DEPTH)[p].r, 2.f);
+    EXPECT_FLOAT_EQ(frame.data(Channel::NORMAL)[p].b, 1.f);
+    EXPECT_FLOAT_EQ(frame.data(Channel::MATERIAL_ID)[p].r, 7.f);
+    EXPECT_FLOAT_EQ(frame.data(Channel::MATERIAL_ID)[0].r, -1.f);
+    EXPECT_FLOAT_EQ(frame.data(Channel::DEPTH)[0].r, 0.f);
+}
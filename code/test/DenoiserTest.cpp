@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "utilities/Denoiser.hpp"
+#include "utilities/Random.hpp"
+
+using namespace NRenderer;
+
+namespace
+{
+    // 左半边和右半边是朝向不同的两个面, 亮度分别为0.2和0.8, 每个像素4个带噪声的采样
+    vector<DenoisePixel> noisyWall(unsigned int width, unsigned int height) {
+        vector<DenoisePixel> pixels(width * height);
+        for (unsigned int i = 0; i < height; i++) {
+            for (unsigned int j = 0; j < width; j++) {
+                bool left = j < width / 2;
+                SurfaceFeature feature{ RGB{ 0.5f }, left ? Vec3{ 1, 0, 0 } : Vec3{ 0, 0, 1 }, 5.f };
+                Pcg32 rng{ hashValues(i * width + j, 0) };
+                for (int k = 0; k < 4; k++) {
+                    float v = (left ? 0.2f : 0.8f) * 2.f * rng.nextFloat();
+                    pixels[i * width + j].add(RGB{ v }, feature);
+                }
+            }
+        }
+        return pixels;
+    }
+
+    // 某一列上与真值的均方误差
+    float columnError(const vector<RGB>& colors, unsigned int width, unsigned int height, unsigned int j, float expected) {
+        float error = 0;
+        for (unsigned int i = 0; i < height; i++) {
+            float d = colors[i * width + j].r - expected;
+            error += d * d;
+        }
+        return error / height;
+    }
+}
+
+TEST(DenoiserTest, ReducesNoiseOnFlatSurface) {
+    const unsigned int width = 64, height = 64;
+    auto pixels = noisyWall(width, height);
+    vector<RGB> raw(width * height);
+    for (size_t p = 0; p < pixels.size(); p++) raw[p] = pixels[p].color / float(pixels[p].n);
+
+    Denoiser denoiser{ width, height, 5, 2 };
+    auto colors = denoiser.run(pixels);
+    ASSERT_EQ(colors.size(), raw.size());
+    for (unsigned int j : { 8u, 56u }) {
+        float expected = j < width / 2 ? 0.2f : 0.8f;
+        EXPECT_LT(columnError(colors, width, height, j, expected), 0.25f * columnError(raw, width, height, j, expected));
+    }
+}
+
+TEST(DenoiserTest, KeepsEdgesBetweenSurfaces) {
+    const unsigned int width = 64, height = 64;
+    Denoiser denoiser{ width, height, 5, 2 };
+    auto colors = denoiser.run(noisyWall(width, height));
+    // 紧挨着边界的两列不互相混合
+    float left = 0, right = 0;
+    for (unsigned int i = 0; i < height; i++) {
+        left += colors[i * width + width / 2 - 1].r;
+        right += colors[i * width + width / 2].r;
+    }
+    EXPECT_NEAR(left / height, 0.2f, 0.03f);
+    EXPECT_NEAR(right / height, 0.8f, 0.1f);
+}
+
+TEST(DenoiserTest, PassesThroughPixelsWithoutSurface) {
+    const unsigned int width = 16, height = 16;
+    vector<DenoisePixel> pixels(width * height);
+    for (auto& p : pixels) p.add(RGB{ 0.5f }, SurfaceFeature{ RGB{ 1 }, Vec3{ 0, 1, 0 }, 1.f });
+    // 直接看到光源的像素: 没有表面特征
+    pixels[5 * width + 5] = {};
+    pixels[5 * width + 5].add(RGB{ 10.f }, SurfaceFeature{});
+    Denoiser denoiser{ width, height, 3, 1 };
+    auto colors = denoiser.run(pixels);
+    EXPECT_FLOAT_EQ(colors[5 * width + 5].r, 10.f);
+    EXPECT_NEAR(colors[5 * width + 6].r, 0.5f, 1e-4f);
+}
@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include "utilities/LightTree.hpp"
+#include "utilities/Random.hpp"
+
+using namespace NRenderer;
+
+namespace
+{
+    // 在盒子 [-100, 100]^3 里随机放置大小、朝向和亮度不同的面光源
+    vector<AreaLight> randomLights(unsigned int n) {
+        vector<AreaLight> lights;
+        Pcg32 rng{ hashValues(n, 49) };
+        for (unsigned int i = 0; i < n; i++) {
+            AreaLight a;
+            a.position = Vec3{ rng.nextFloat(), rng.nextFloat(), rng.nextFloat() } * 200.f - 100.f;
+            Vec3 u{ rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f };
+            Vec3 w{ rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f };
+            float size = 1 + 9 * rng.nextFloat();
+            a.u = glm::normalize(u) * size;
+            a.v = glm::normalize(glm::cross(u, w)) * size;
+            a.radiance = Vec3{ 0.1f + 10 * rng.nextFloat() };
+            lights.push_back(a);
+        }
+        return lights;
+    }
+
+    // 与组件中xAreaLight相同的求交
+    float hitLight(const AreaLight& a, const Vec3& origin, const Vec3& direction, float tMax) {
+        Vec3 normal = glm::cross(a.u, a.v);
+        float d = glm::dot(direction, normal);
+        if (fabs(d) < 1e-7f) return tMax;
+        float t = glm::dot(a.position - origin, normal) / d;
+        if (t >= tMax || t < 1e-6f) return tMax;
+        Vec3 local = glm::inverse(Mat3x3{ a.u, a.v, normal }) * (origin + t * direction - a.position);
+        return local.x >= 0 && local.x <= 1 && local.y >= 0 && local.y <= 1 ? t : tMax;
+    }
+}
+
+TEST(LightTreeTest, PmfSumsToOneAndMatchesSampling) {
+    auto lights = randomLights(300);
+    for (bool twoSided : { true, false }) {
+        LightTree tree;
+        tree.build(lights, twoSided);
+        Pcg32 rng{ 7 };
+        for (int q = 0; q < 20; q++) {
+            Vec3 p = Vec3{ rng.nextFloat(), rng.nextFloat(), rng.nextFloat() } * 300.f - 150.f;
+            Vec3 n = q % 2 ? glm::normalize(Vec3{ rng.nextFloat() - 0.5f, 1, rng.nextFloat() - 0.5f }) : Vec3{ 0 };
+            double sum = 0;
+            for (unsigned int i = 0; i < lights.size(); i++) {
+                float pmf = tree.pmf(p, n, i);
+                sum += pmf;
+                // 能照到p的光源必须能被选到
+                auto& a = lights[i];
+                bool front = glm::dot(p - a.position, glm::cross(a.u, a.v)) > 0;
+                if ((twoSided || front) && n == Vec3{ 0 }) EXPECT_GT(pmf, 0.f);
+            }
+            // 单面光源在内部节点被剔除时会丢失一部分概率, 丢失的部分估计为0
+            EXPECT_LE(sum, 1.0 + 1e-4);
+            if (twoSided && n == Vec3{ 0 }) EXPECT_NEAR(sum, 1.0, 1e-4);
+            for (int s = 0; s < 50; s++) {
+                auto [light, pmf] = tree.sample(p, n, rng.nextFloat());
+                if (light < 0) continue;
+                EXPECT_GT(pmf, 0.f);
+                EXPECT_NEAR(pmf, tree.pmf(p, n, light), 1e-5f * pmf);
+            }
+        }
+    }
+}
+
+TEST(LightTreeTest, PrefersNearAndBrightLights) {
+    vector<AreaLight> lights(2);
+    for (auto& a : lights) {
+        a.u = { 10, 0, 0 };
+        a.v = { 0, 0, 10 };
+    }
+    lights[0].position = { 0, 100, 0 };
+    lights[1].position = { 1000, 100, 0 };
+    LightTree tree;
+    tree.build(lights, true);
+    Vec3 p{ 5, 0, 5 }, n{ 0, 1, 0 };
+    EXPECT_GT(tree.pmf(p, n, 0), 0.9f);
+    lights[1].radiance = Vec3{ 1e4f };
+    tree.build(lights, true);
+    EXPECT_GT(tree.pmf(p, n, 1), tree.pmf(p, n, 0));
+}
+
+TEST(LightTreeTest, OneSidedLightsBehindAreSkipped) {
+    vector<AreaLight> lights(1);
+    lights[0].position = { 0, 10, 0 };
+    // u x v 朝 -y, 只照亮下方
+    lights[0].u = { 1, 0, 0 };
+    lights[0].v = { 0, 0, 1 };
+    LightTree tree;
+    tree.build(lights, false);
+    EXPECT_FLOAT_EQ(tree.pmf({ 0, 0, 0 }, { 0, 1, 0 }, 0), 1.f);
+    EXPECT_EQ(tree.sample({ 0, 20, 0 }, { 0, 1, 0 }, 0.5f).first, -1);
+    EXPECT_EQ(tree.pmf({ 0, 20, 0 }, { 0, 1, 0 }, 0), 0.f);
+}
+
+TEST(LightTreeTest, IntersectMatchesBruteForce) {
+    auto lights = randomLights(500);
+    lights[3].radiance = Vec3{ 0 };
+    LightTree tree;
+    tree.build(lights, true);
+    Pcg32 rng{ 11 };
+    int hits = 0;
+    for (int r = 0; r < 2000; r++) {
+        Vec3 origin = Vec3{ rng.nextFloat(), rng.nextFloat(), rng.nextFloat() } * 200.f - 100.f;
+        Vec3 direction = glm::normalize(Vec3{ rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f, rng.nextFloat() - 0.5f });
+        float expected = FLT_MAX;
+        for (auto& a : lights) expected = hitLight(a, origin, direction, expected);
+        float found = FLT_MAX;
+        tree.intersect(origin, direction, FLT_MAX, [&](unsigned int light, float tMax) {
+            float h = hitLight(lights[light], origin, direction, tMax);
+            found = min(found, h);
+            return h;
+        });
+        EXPECT_EQ(found, expected);
+        if (expected < FLT_MAX) hits++;
+    }
+    EXPECT_GT(hits, 100);
+}
@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include "KDTree.hpp"
+#include "samplers/Halton.hpp"
+
+#include <random>
+#include <functional>
+#include <cmath>
+
+using namespace PhotonMapping;
+
+// 按 resource/photon_mapping.scn 的顶灯向地面发射光子, 与渲染器相同的映射:
+// 光源上取 position + [0, 1]u + [0, 1]v, 方向按余弦分布(z^2均匀)
+class PhotonEmissionTest : public ::testing::Test
+{
+protected:
+    constexpr static size_t photonNums = 100000;
+    constexpr static size_t neighbors = 128;
+    constexpr static int resolution = 32;
+    constexpr static float C_PI = 3.14159265358979323846f;
+    const Vec3 lightPosition{ 60, 275, 1088 };
+    const Vec3 lightU{ -120, 0, 0 };
+    const Vec3 lightV{ 0, 0, -120 };
+    const float floorY = -278;
+
+    // 第dim维的样本, 返回[0, 1)
+    using Sequence = function<float(uint64_t, unsigned int)>;
+
+    vector<Photon> emit(const Sequence& sample) const {
+        vector<Photon> photons;
+        for (uint64_t i = 0; i < photonNums; i++) {
+            Vec3 origin = lightPosition + sample(i, 0) * lightU + sample(i, 1) * lightV;
+            float z = sqrt(sample(i, 2));
+            float phi = 2 * C_PI * sample(i, 3);
+            float r = sqrt(glm::max(0.f, 1 - z * z));
+            // 光源法线朝下, 局部z轴对应世界-y
+            Vec3 direction{ cos(phi) * r, -z, sin(phi) * r };
+            if (z <= 0) continue;
+            float t = (floorY - origin.y) / direction.y;
+            Vec3 p = origin + t * direction;
+            if (abs(p.x) <= 278 && p.z >= 750 && p.z <= 1306) {
+                photons.push_back(Photon(p, direction, Vec3{ 1 }));
+            }
+        }
+        return photons;
+    }
+
+    // 光子面密度的参考值: N * E_q[cosLight * cosFloor / (pi d^2)], 在光源上做中点积分
+    float referenceDensity(const Vec3& p) const {
+        const int n = 16;
+        float sum = 0;
+        for (int i = 0; i < n; i++) for (int j = 0; j < n; j++) {
+            Vec3 q = lightPosition + (i + 0.5f) / n * lightU + (j + 0.5f) / n * lightV;
+            Vec3 d = q - p;
+            float dist2 = glm::dot(d, d);
+            // 光源朝下, 地面朝上, 两个余弦相等
+            sum += d.y * d.y / dist2 / (C_PI * dist2);
+        }
+        return float(photonNums) * sum / (n * n);
+    }
+
+    // 地面中部的k近邻密度估计相对参考值的RMSE
+    double relativeRMSE(const Sequence& sample) const {
+        auto photons = emit(sample);
+        KDTree tree;
+        tree.buildTree(photons);
+        double squareSum = 0, mean = 0;
+        for (int i = 0; i < resolution; i++) for (int j = 0; j < resolution; j++) {
+            Vec3 p{ -200 + 400 * (i + 0.5f) / resolution, floorY, 830 + 400 * (j + 0.5f) / resolution };
+            auto [knn, radius2] = tree.search(p, neighbors);
+            double estimate = float(knn.size()) / (C_PI * radius2);
+            double reference = referenceDensity(p);
+            squareSum += (estimate - reference) * (estimate - reference);
+            mean += reference;
+        }
+        mean /= resolution * resolution;
+        return sqrt(squareSum / (resolution * resolution)) / mean;
+    }
+};
+
+TEST_F(PhotonEmissionTest, HaltonIsStratified) {
+    Halton halton{ 3 };
+    for (unsigned int dim = 0; dim < 2; dim++) {
+        // 底为2(3)时前 2^10 (3^6) 个点每个长度为 1/2^10 (1/3^6) 的区间恰好一个
+        size_t n = dim == 0 ? 1024 : 729;
+        vector<int> cells(n, 0);
+        for (uint64_t i = 0; i < n; i++) {
+            float v = halton.sample(i, dim);
+            ASSERT_GE(v, 0.f);
+            ASSERT_LT(v, 1.f);
+            cells[min(size_t(double(v) * n), n - 1)]++;
+        }
+        for (auto c : cells) EXPECT_EQ(c, 1);
+    }
+}
+
+// 置换只依赖PCG, 各平台的标准库得到相同的序列, 光子图缓存的键才能通用
+TEST_F(PhotonEmissionTest, HaltonIsReproducible) {
+    Halton halton{};
+    const float expected[Halton::dimensions] = {
+        0.390441865f, 0.142457962f, 0.761327982f, 0.024354931f, 0.449969262f, 0.70845437f, 0.822947919f, 0.466819108f
+    };
+    for (unsigned int dim = 0; dim < Halton::dimensions; dim++) {
+        EXPECT_FLOAT_EQ(halton.sample(12345, dim), expected[dim]);
+    }
+}
+
+TEST_F(PhotonEmissionTest, QMCReducesDensityNoise) {
+    mt19937 e{ 5 };
+    uniform_real_distribution<float> u{ 0, 1 };
+    double randomRMSE = relativeRMSE([&](uint64_t, unsigned int) { return u(e); });
+    Halton halton{};
+    double qmcRMSE = relativeRMSE([&](uint64_t i, unsigned int dim) { return halton.sample(i, dim); });
+    cout << "relative RMSE: random " << randomRMSE << ", halton " << qmcRMSE << endl;
+    EXPECT_LT(qmcRMSE, randomRMSE);
+}
@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+#include "KDTree.hpp"
+
+#include <random>
+#include <chrono>
+#include <cmath>
+
+using namespace PhotonMapping;
+
+// 光子按 resource/photon_mapping.scn 的光源对五面墙的直接照度分布
+// 墙: x, y ∈ [-278, 278], z ∈ [750, 1306], 光源中心 (0, 275, 1028)
+class PhotonKDTreeTest : public ::testing::Test
+{
+protected:
+    constexpr static size_t photonNums = 200000;
+    constexpr static size_t neighbors = 250;
+    constexpr static int resolution = 64;
+    const Vec3 lightCenter{ 0, 275, 1028 };
+
+    struct Wall
+    {
+        Vec3 origin;
+        Vec3 u;
+        Vec3 v;
+        Vec3 normal;
+    };
+    vector<Wall> walls;
+    vector<Photon> photons;
+    KDTree tree;
+
+    float irradiance(const Vec3& p, const Vec3& n) const {
+        Vec3 d = lightCenter - p;
+        float dist2 = glm::dot(d, d);
+        float cosSurface = glm::max(0.f, glm::dot(n, d) / sqrt(dist2));
+        float cosLight = glm::max(0.f, d.y / sqrt(dist2));
+        return cosSurface * cosLight / dist2;
+    }
+
+    void SetUp() override {
+        walls = {
+            { { 278, -278, 750 }, { 0, 556, 0 }, { 0, 0, 556 }, { -1, 0, 0 } },
+            { { -278, -278, 750 }, { 0, 556, 0 }, { 0, 0, 556 }, { 1, 0, 0 } },
+            { { -278, 278, 750 }, { 556, 0, 0 }, { 0, 0, 556 }, { 0, -1, 0 } },
+            { { -278, -278, 750 }, { 556, 0, 0 }, { 0, 0, 556 }, { 0, 1, 0 } },
+            { { -278, -278, 1306 }, { 556, 0, 0 }, { 0, 556, 0 }, { 0, 0, -1 } }
+        };
+        float maxIrradiance = 0;
+        for (auto& w : walls) {
+            for (int i = 0; i <= 32; i++) for (int j = 0; j <= 32; j++) {
+                maxIrradiance = glm::max(maxIrradiance, irradiance(w.origin + w.u * (i / 32.f) + w.v * (j / 32.f), w.normal));
+            }
+        }
+        // 拒绝采样, 光子密度正比于照度, 每个光子功率相同
+        default_random_engine e{ 7 };
+        uniform_real_distribution<float> u{ 0, 1 };
+        while (photons.size() < photonNums) {
+            auto& w = walls[size_t(u(e) * walls.size()) % walls.size()];
+            Vec3 p = w.origin + w.u * u(e) + w.v * u(e);
+            if (u(e) * maxIrradiance < irradiance(p, w.normal)) {
+                photons.push_back(Photon(p, -w.normal, Vec3{ 1 }));
+            }
+        }
+        tree.buildTree(photons);
+    }
+
+    // 在后墙和地面上各取 resolution * resolution 个查询点做密度估计, 返回耗时(秒)
+    double render(float epsilon, vector<float>& image, size_t& visited) {
+        image.clear();
+        visited = 0;
+        auto start = chrono::steady_clock::now();
+        for (int wall : { 3, 4 }) {
+            auto& w = walls[wall];
+            for (int i = 0; i < resolution; i++) for (int j = 0; j < resolution; j++) {
+                Vec3 p = w.origin + w.u * ((i + 0.5f) / resolution) + w.v * ((j + 0.5f) / resolution);
+                auto [knn, radius2] = tree.search(p, neighbors, numeric_limits<float>::max(), &visited, epsilon);
+                image.push_back(radius2 > 0 ? float(knn.size()) / (3.1415926f * radius2) : 0.f);
+            }
+        }
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+TEST_F(PhotonKDTreeTest, ExactSearchMatchesBruteForce) {
+    default_random_engine e{ 11 };
+    uniform_int_distribution<size_t> pick{ 0, photons.size() - 1 };
+    for (int q = 0; q < 20; q++) {
+        Vec3 target = photons[pick(e)].position + Vec3{ 1, 1, 1 };
+        vector<float> dist;
+        for (auto& p : photons) dist.push_back(glm::dot(p.position - target, p.position - target));
+        nth_element(dist.begin(), dist.begin() + neighbors - 1, dist.end());
+        auto [knn, radius2] = tree.search(target, neighbors);
+        EXPECT_EQ(knn.size(), neighbors);
+        EXPECT_FLOAT_EQ(radius2, dist[neighbors - 1]);
+    }
+}
+
+TEST_F(PhotonKDTreeTest, ApproximateSearchRMSE) {
+    vector<float> exact, approx;
+    size_t exactVisited, approxVisited;
+    double exactTime = render(0.f, exact, exactVisited);
+    float mean = 0;
+    for (auto v : exact) mean += v / exact.size();
+
+    for (float epsilon : { 0.1f, 0.5f, 1.0f }) {
+        double approxTime = render(epsilon, approx, approxVisited);
+        ASSERT_EQ(approx.size(), exact.size());
+        double squareSum = 0;
+        for (size_t i = 0; i < exact.size(); i++) {
+            squareSum += double(approx[i] - exact[i]) * (approx[i] - exact[i]);
+        }
+        double relativeRMSE = sqrt(squareSum / exact.size()) / mean;
+        cout << "epsilon " << epsilon << ": relative RMSE " << relativeRMSE
+            << ", nodes " << approxVisited << "/" << exactVisited
+            << ", time " << approxTime * 1000 << "ms/" << exactTime * 1000 << "ms" << endl;
+
+        EXPECT_LT(approxVisited, exactVisited);
+        // 第k近距离最多放大 (1 + epsilon) 倍, 密度最多低估 (1 + epsilon)^2 倍
+        EXPECT_LT(relativeRMSE, 1.0 - 1.0 / ((1.0 + epsilon) * (1.0 + epsilon)));
+    }
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "samplers/SobolSampler.hpp"
+#include "samplers/PMJ02Sampler.hpp"
+#include "samplers/HaltonSampler.hpp"
+
+#include <random>
+#include <cmath>
+
+using namespace SimplePathTracer;
+
+// 每个2的幂长的前缀在所有 2^a * 2^(m-a) 的初等区间上都恰好各有一个样本
+static bool isStratified(const PixelSampler& sampler, uint32_t pixel, uint32_t dim, uint32_t maxSamples) {
+    for (uint32_t n = 2, m = 1; n <= maxSamples; n *= 2, m++) {
+        for (uint32_t a = 0; a <= m; a++) {
+            vector<int> cells(n, 0);
+            for (uint32_t i = 0; i < n; i++) {
+                auto p = sampler.get2d(pixel, i, dim);
+                uint32_t cx = uint32_t(double(p.x) * (1u << a));
+                uint32_t cy = uint32_t(double(p.y) * (1u << (m - a)));
+                if (cells[(cy << a) | cx]++ > 0) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 在若干像素上估计一个光滑函数的积分, 返回均方误差
+static double integrationMSE(const function<Vec2(uint32_t, uint32_t)>& sample, uint32_t n) {
+    auto f = [](const Vec2& p) { return exp(-8 * ((p.x - 0.4) * (p.x - 0.4) + (p.y - 0.6) * (p.y - 0.6))); };
+    const int res = 1000;
+    double reference = 0;
+    for (int i = 0; i < res; i++) for (int j = 0; j < res; j++) reference += f({ (i + 0.5f) / res, (j + 0.5f) / res });
+    reference /= res * res;
+    const uint32_t pixels = 1000;
+    double squareSum = 0;
+    for (uint32_t p = 0; p < pixels; p++) {
+        double estimate = 0;
+        for (uint32_t i = 0; i < n; i++) estimate += f(sample(p, i));
+        estimate /= n;
+        squareSum += (estimate - reference) * (estimate - reference);
+    }
+    return squareSum / pixels;
+}
+
+TEST(PixelSamplerTest, SobolIsStratified) {
+    SobolSampler sobol{};
+    for (uint32_t pixel : { 0u, 17u, 4096u }) {
+        for (uint32_t dim : { 0u, 4u, 7u }) {
+            EXPECT_TRUE(isStratified(sobol, pixel, dim, 256));
+        }
+    }
+}
+
+TEST(PixelSamplerTest, PMJ02IsStratified) {
+    PMJ02Sampler pmj{};
+    for (uint32_t pixel : { 0u, 17u, 4096u }) {
+        for (uint32_t dim : { 0u, 4u, 7u }) {
+            EXPECT_TRUE(isStratified(pmj, pixel, dim, PMJ02Sampler::tableSize));
+        }
+    }
+}
+
+TEST(PixelSamplerTest, SamplesAreDeterministicAndInRange) {
+    SobolSampler sobol{};
+    PMJ02Sampler pmj{};
+    HaltonSampler halton{};
+    for (const PixelSampler* s : { (const PixelSampler*)&sobol, (const PixelSampler*)&pmj, (const PixelSampler*)&halton }) {
+        for (uint32_t i = 0; i < 1000; i++) {
+            float v = s->get1d(i % 7, i, i % 100);
+            EXPECT_EQ(v, s->get1d(i % 7, i, i % 100));
+            EXPECT_GE(v, 0.f);
+            EXPECT_LT(v, 1.f);
+            auto p = s->get2d(i % 7, i, i % 100);
+            EXPECT_LT(p.x, 1.f);
+            EXPECT_LT(p.y, 1.f);
+        }
+    }
+}
+
+TEST(PixelSamplerTest, LowerErrorThanIndependent) {
+    mt19937 e{ 3 };
+    uniform_real_distribution<float> u{ 0, 1 };
+    SobolSampler sobol{};
+    PMJ02Sampler pmj{};
+    HaltonSampler halton{};
+    for (uint32_t n : { 16u, 64u }) {
+        double random = integrationMSE([&](uint32_t, uint32_t) { return Vec2{ u(e), u(e) }; }, n);
+        double sobolMSE = integrationMSE([&](uint32_t p, uint32_t i) { return sobol.get2d(p, i, 4); }, n);
+        double pmjMSE = integrationMSE([&](uint32_t p, uint32_t i) { return pmj.get2d(p, i, 4); }, n);
+        double haltonMSE = integrationMSE([&](uint32_t p, uint32_t i) { return halton.get2d(p, i, 4); }, n);
+        cout << n << " spp MSE: independent " << random << ", sobol " << sobolMSE
+            << ", pmj02 " << pmjMSE << ", halton " << haltonMSE << endl;
+        EXPECT_LT(sobolMSE, random / 4);
+        EXPECT_LT(pmjMSE, random / 4);
+        EXPECT_LT(haltonMSE, random);
+    }
+}
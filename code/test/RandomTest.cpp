@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+#include "utilities/Random.hpp"
+
+#include <vector>
+
+using namespace NRenderer;
+
+TEST(RandomTest, SameSeedSameSequence) {
+    Pcg32 a{ hashValues(12345, 7) }, b{ hashValues(12345, 7) };
+    Pcg32 otherSeed{ hashValues(12345, 8) }, otherStream{ hashValues(12345, 7), 1 };
+    int sameSeed = 0, sameStream = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint32_t x = a.nextUInt();
+        EXPECT_EQ(x, b.nextUInt());
+        if (x == otherSeed.nextUInt()) sameSeed++;
+        if (x == otherStream.nextUInt()) sameStream++;
+    }
+    EXPECT_LT(sameSeed, 2);
+    EXPECT_LT(sameStream, 2);
+}
+
+TEST(RandomTest, FloatsAreUniform) {
+    // 按像素下标构造的相邻流, 取每个流的前几个数, 检查二维直方图的卡方
+    const int bins = 16, pixels = 64 * 1024;
+    vector<int> histogram(bins * bins, 0);
+    for (uint32_t p = 0; p < pixels; p++) {
+        Pcg32 rng{ hashValues(p, 0) };
+        for (int k = 0; k < 2; k++) {
+            auto v = rng.next2d();
+            ASSERT_GE(v.x, 0.f);
+            ASSERT_LT(v.x, 1.f);
+            ASSERT_GE(v.y, 0.f);
+            ASSERT_LT(v.y, 1.f);
+            histogram[int(v.y * bins) * bins + int(v.x * bins)]++;
+        }
+    }
+    double expected = 2.0 * pixels / (bins * bins), chi2 = 0;
+    for (int h : histogram) chi2 += (h - expected) * (h - expected) / expected;
+    // 255个自由度, 均值255, 标准差约22.6
+    EXPECT_LT(chi2, 255 + 5 * 22.6);
+}
+
+TEST(RandomTest, HashedFloatsIgnoreCallOrder) {
+    vector<float> forward, backward;
+    for (uint64_t i = 0; i < 100; i++) forward.push_back(toUnitFloat(uint32_t(hashValues(i, 3))));
+    for (uint64_t i = 100; i-- > 0;) backward.push_back(toUnitFloat(uint32_t(hashValues(i, 3))));
+    for (size_t i = 0; i < 100; i++) EXPECT_EQ(forward[i], backward[99 - i]);
+}
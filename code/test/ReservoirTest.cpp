@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+#include "Reservoir.hpp"
+#include "utilities/Random.hpp"
+
+using namespace SimplePathTracer;
+
+TEST(ReservoirTest, SelectsProportionallyToWeight) {
+    const float weights[] = { 1, 2, 3, 4 };
+    int counts[4] = { 0 };
+    Pcg32 rng{ 50 };
+    const int trials = 100000;
+    for (int t = 0; t < trials; t++) {
+        Reservoir r;
+        for (int i = 0; i < 4; i++) r.add(i, Vec3{ float(i) }, weights[i], weights[i], rng.nextFloat());
+        ASSERT_GE(r.light, 0);
+        EXPECT_EQ(r.point, Vec3{ float(r.light) });
+        counts[r.light]++;
+    }
+    for (int i = 0; i < 4; i++) EXPECT_NEAR(counts[i] / float(trials), weights[i] / 10.f, 0.01f);
+}
+
+TEST(ReservoirTest, ResampledEstimateIsUnbiased) {
+    // 在[0, 1)上均匀取候选, 目标函数为x^2, 估计 f(x) = x^2 的积分 1/3
+    Pcg32 rng{ 51 };
+    const int trials = 50000;
+    double sum = 0;
+    for (int t = 0; t < trials; t++) {
+        Reservoir r;
+        for (int m = 0; m < 8; m++) {
+            float x = rng.nextFloat();
+            r.add(0, Vec3{ x }, x * x, x * x, rng.nextFloat());
+        }
+        r.computeWeight(r.M);
+        sum += r.point.x * r.point.x * r.W;
+    }
+    EXPECT_NEAR(sum / trials, 1.0 / 3, 0.005);
+}
+
+TEST(ReservoirTest, MergeKeepsCountAndWeight) {
+    Reservoir a, b;
+    a.add(0, Vec3{ 1 }, 2, 2, 0.5f);
+    a.computeWeight(a.M);
+    b.add(1, Vec3{ 2 }, 4, 4, 0.5f);
+    b.add(2, Vec3{ 3 }, 4, 4, 0.99f);
+    b.computeWeight(b.M);
+    EXPECT_FLOAT_EQ(b.W, 0.5f * 8 / 4);
+
+    // MIS权重之和为1时, 合并后 f * W 的期望与各自的估计一致
+    Reservoir s;
+    s.merge(a, 2, 0.5f, 0.f);
+    s.merge(b, 4, 0.5f, 0.99f);
+    s.computeWeight(1);
+    EXPECT_FLOAT_EQ(s.M, 3.f);
+    EXPECT_EQ(s.light, 0);
+    EXPECT_FLOAT_EQ(s.weightSum, 2 * a.W * 0.5f + 4 * b.W * 0.5f);
+    EXPECT_FLOAT_EQ(s.W, s.weightSum / 2);
+
+    // 空的蓄水池只增加候选数
+    Reservoir empty;
+    empty.M = 4;
+    s.merge(empty, 0, 1, 0.f);
+    EXPECT_FLOAT_EQ(s.M, 7.f);
+    EXPECT_EQ(s.light, 0);
+}
@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+#include "utilities/TileScheduler.hpp"
+
+#include <atomic>
+
+using namespace NRenderer;
+
+TEST(TileSchedulerTest, CoversEveryPixelOnce) {
+    const unsigned int width = 131, height = 77;
+    TileScheduler scheduler{ width, height, 16, 4 };
+    vector<atomic<int>> hits(width * height);
+    scheduler.run([&](const Tile& tile, unsigned int) {
+        for (unsigned int i = tile.y0; i < tile.y1; i++) {
+            for (unsigned int j = tile.x0; j < tile.x1; j++) {
+                hits[i * width + j]++;
+            }
+        }
+    });
+    for (auto& h : hits) EXPECT_EQ(h.load(), 1);
+    size_t tiles = 0;
+    for (auto& s : scheduler.stats()) tiles += s.tiles;
+    EXPECT_EQ(tiles, scheduler.size());
+}
+
+TEST(TileSchedulerTest, HilbertOrderIsContiguous) {
+    TileScheduler scheduler{ 128, 128, 16, 1 };
+    vector<Tile> order;
+    scheduler.run([&](const Tile& tile, unsigned int) { order.push_back(tile); });
+    ASSERT_EQ(order.size(), 64u);
+    // 单线程按曲线顺序执行, 相邻的块共享一条边
+    for (size_t k = 1; k < order.size(); k++) {
+        unsigned int dx = order[k].x0 > order[k - 1].x0 ? order[k].x0 - order[k - 1].x0 : order[k - 1].x0 - order[k].x0;
+        unsigned int dy = order[k].y0 > order[k - 1].y0 ? order[k].y0 - order[k - 1].y0 : order[k - 1].y0 - order[k].y0;
+        EXPECT_EQ(dx + dy, 16u);
+    }
+}
+
+TEST(TileSchedulerTest, StealsFromBusyThreads) {
+    TileScheduler scheduler{ 256, 256, 16, 4 };
+    // 第一段的块耗时远大于其他块, 其余线程做完自己的块以后应当帮忙
+    unsigned int heavy = scheduler.size() / 4;
+    scheduler.run([&](const Tile& tile, unsigned int) {
+        if (tile.index < heavy) this_thread::sleep_for(chrono::milliseconds(2));
+    });
+    size_t steals = 0;
+    for (auto& s : scheduler.stats()) steals += s.steals;
+    EXPECT_GT(steals, 0u);
+    EXPECT_GT(scheduler.stats()[0].busy, 0.0);
+}
@@ -0,0 +1,223 @@
+// 生成多光源压力测试场景: Cornell box 里放置大量位置、朝向、大小和功率各不相同的小面光源
+// 用法: ManyLightsScene [输出文件] [光源数量] [随机种子]
+#include "utilities/Random.hpp"
+#include "geometry/vec.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+using namespace NRenderer;
+using namespace std;
+
+namespace
+{
+    // 房间为 [-278, 278]^3, 平移到 z = 1028
+    const Vec3 roomCenter{ 0, 0, 1028 };
+    const float roomHalf = 278;
+
+    const char* geometry = R"(Begin Material
+
+Material White
+
+Prop diffuseColor RGB 0.725 0.71 0.68
+
+Material Red
+
+Prop diffuseColor RGB 0.63 0.065 0.05
+
+Material Green
+
+Prop diffuseColor RGB 0.14 0.45 0.091
+
+
+End
+
+Begin Model
+
+Model Wall
+Translation 0.0 0.0 1028.0
+Plane LeftWall Red
+N  -1.0 0.0 0.0
+P 278.0 278.0 278.0
+U 0 -556.0 0
+V 0 0 -556.0
+
+Plane RightWall Green
+N 1.0 0.0 0.0
+P -278.0 278.0 278
+U 0 -556 0
+V 0 0 -556.0
+
+Plane TopWall White
+N 0.0 -1.0 0.0
+P 278.0 278.0 278
+U -556 0 0
+V 0 0 -556
+
+Plane BottomWall White
+N 0.0 1.0 0.0
+P 278.0 -278.0 278
+U -556 0 0
+V 0 0 -556
+
+Plane BackWall White
+N 0.0 0.0 -1.0
+P 278.0 278.0 278
+U -556 0 0
+V 0 -556 0
+
+End
+
+Begin Model
+
+Model Sphere
+Translation -100 -228 800
+
+Sphere Sphere White
+N 0 0 1
+P 0 0 0
+R 50
+
+End
+
+Begin Model
+Model Box
+Translation -100 -178 1150
+
+Plane BoxPlane1 White
+N 0 1 0
+P 100 100 0
+U -100 0 100
+V -100 0 -100
+
+Plane BoxPlane2 White
+N 0 -1 0
+P 100 -100 0
+U -100 0 100
+V -100 0 -100
+
+Plane BoxPlane3 White
+N 0.7071 0 -0.7071
+P 100 -100 0
+U 0 200 0
+V -100 0 -100
+
+Plane BoxPlane4 White
+N 0.7071 0 0.7071
+P 100 -100 0
+U 0 200 0
+V -100 0 100
+
+Plane BoxPlane5 White
+N -0.7071 0 0.7071
+P -100 -100 0
+U 0 200 0
+V 100 0 100
+
+Plane BoxPlane6 White
+N -0.7071 0 -0.7071
+P -100 -100 0
+U 0 200 0
+V 100 0 -100
+
+End
+
+)";
+
+    struct Quad
+    {
+        Vec3 position;
+        Vec3 u;
+        Vec3 v;
+        Vec3 radiance;
+    };
+
+    // 以normal为 u x v 方向、中心为center、边长为size的正方形
+    Quad makeQuad(const Vec3& center, const Vec3& normal, float size, float angle) {
+        Vec3 helper = fabs(normal.y) < 0.9f ? Vec3{ 0, 1, 0 } : Vec3{ 1, 0, 0 };
+        Vec3 t = glm::normalize(glm::cross(helper, normal));
+        Vec3 b = glm::cross(normal, t);
+        Vec3 u = (cos(angle) * t + sin(angle) * b) * size;
+        Vec3 v = glm::cross(normal, u);
+        return { center - (u + v) * 0.5f, u, v, Vec3{ 0 } };
+    }
+
+    Vec3 uniformSphere(Pcg32& rng) {
+        float z = 1 - 2 * rng.nextFloat();
+        float r = sqrt(max(0.f, 1 - z * z));
+        float phi = 2 * 3.14159265f * rng.nextFloat();
+        return { r * cos(phi), r * sin(phi), z };
+    }
+}
+
+int main(int argc, char** argv) {
+    string path = argc > 1 ? argv[1] : "many_lights.scn";
+    unsigned int count = argc > 2 ? unsigned(stoul(argv[2])) : 1000;
+    uint64_t seed = argc > 3 ? stoull(argv[3]) : 1;
+    Pcg32 rng{ hashValues(seed, count) };
+
+    vector<Quad> lights;
+    for (unsigned int i = 0; i < count; i++) {
+        float kind = rng.nextFloat();
+        float size = 4 + 16 * rng.nextFloat();
+        float angle = 6.2831853f * rng.nextFloat();
+        // 与墙面的距离随机, 避免相互重叠的光源共面
+        float offset = 1 + 4 * rng.nextFloat();
+        Vec3 center, normal;
+        if (kind < 0.4f) {
+            // 天花板, 朝下
+            center = { (rng.nextFloat() * 2 - 1) * (roomHalf - 15), roomHalf - offset, (rng.nextFloat() * 2 - 1) * (roomHalf - 15) };
+            normal = { 0, -1, 0 };
+        }
+        else if (kind < 0.7f) {
+            // 左、右、后墙, 朝房间内
+            int wall = int(rng.nextFloat() * 3);
+            float a = (rng.nextFloat() * 2 - 1) * (roomHalf - 15);
+            float h = (rng.nextFloat() * 2 - 1) * (roomHalf - 15);
+            if (wall == 0) { center = { roomHalf - offset, h, a }; normal = { -1, 0, 0 }; }
+            else if (wall == 1) { center = { -roomHalf + offset, h, a }; normal = { 1, 0, 0 }; }
+            else { center = { a, h, roomHalf - offset }; normal = { 0, 0, -1 }; }
+        }
+        else {
+            // 房间上半部分悬空, 朝向随机
+            center = { (rng.nextFloat() * 2 - 1) * (roomHalf - 30), rng.nextFloat() * (roomHalf - 30), (rng.nextFloat() * 2 - 1) * (roomHalf - 30) };
+            normal = uniformSphere(rng);
+        }
+        Quad q = makeQuad(center + roomCenter, normal, size, angle);
+        // 亮度在两个数量级内对数均匀分布, 颜色随机偏色
+        float intensity = exp(log(0.1f) + rng.nextFloat() * log(100.f));
+        Vec3 tint{ 0.5f + rng.nextFloat(), 0.5f + rng.nextFloat(), 0.5f + rng.nextFloat() };
+        q.radiance = intensity * tint;
+        lights.push_back(q);
+    }
+    // 总功率与原Cornell box的顶光相同
+    float total = 0;
+    for (auto& q : lights) {
+        total += glm::dot(q.radiance, Vec3{ 0.2126f, 0.7152f, 0.0722f }) * glm::length(glm::cross(q.u, q.v));
+    }
+    float target = glm::dot(Vec3{ 47.8384f, 38.5664f, 31.0808f }, Vec3{ 0.2126f, 0.7152f, 0.0722f }) * 120 * 120;
+    float scale = total > 0 ? target / total : 1.f;
+
+    ofstream out(path);
+    if (!out) {
+        cerr << "Cannot open " << path << endl;
+        return 1;
+    }
+    out << "# " << count << " area lights, seed " << seed << ", generated by ManyLightsScene\n\n" << geometry;
+    out << "Begin Light\n\n";
+    for (unsigned int i = 0; i < lights.size(); i++) {
+        auto& q = lights[i];
+        Vec3 radiance = q.radiance * scale;
+        out << "Area Light" << i << "\n"
+            << "IRV " << radiance.r << " " << radiance.g << " " << radiance.b << "\n"
+            << "P " << q.position.x << " " << q.position.y << " " << q.position.z << "\n"
+            << "U " << q.u.x << " " << q.u.y << " " << q.u.z << "\n"
+            << "V " << q.v.x << " " << q.v.y << " " << q.v.z << "\n\n";
+    }
+    out << "End\n";
+    cout << "Wrote " << lights.size() << " lights to " << path << endl;
+    return 0;
+}